@@ -78,27 +78,75 @@ proc insert_sql {sql} {
     return $sid
 }
 
+# Session rows are inserted in batches with executemany: one round trip
+# per batch instead of one per input line
+set batch_size 1000
+set pending_params {}
+set pending_data   {}
+
 proc insert_session {data} { 
-    global ses_insert
     global vallist
+    global batch_size
+    global pending_params
+    global pending_data
 
     lassign $data {*}$vallist
     set sesscnt 1
 
-    set currsql  [string range $currsql  0 31950]
-    set parsesql [string range $parsesql 0 31950]
-
     set currsql  [insert_sql $currsql]
     set parsesql [insert_sql $parsesql]
 
-    set catched {}
-    if {[catch { 
-        set resset [$ses_insert execute]
-        $resset close
-    } catched]} { 
-        puts "ERROR ERROR ERROR $catched"
-        puts "ERROR ERROR ERROR $data"
+    set params {}
+    foreach name [list tstamp sesscnt {*}[lrange $vallist 1 end]] {
+        dict set params $name [set $name]
+    }
+    lappend pending_params $params
+    lappend pending_data   $data
+
+    if {[llength $pending_params] >= $batch_size} {
+        flush_sessions
+    }
+}
+
+proc flush_sessions {} { 
+    global ses_insert
+    global pending_params
+    global pending_data
+
+    if {[llength $pending_params] == 0} {
+        return
+    }
+
+    # Rows executemany did not get to (unused) are sent again until none
+    # are left or a round makes no progress; those are then reported too
+    set params $pending_params
+    set datas  $pending_data
+    while {[llength $params] > 0} {
+        set catched {}
+        if {[catch {$ses_insert executemany $params} catched]} {
+            puts "ERROR ERROR ERROR $catched"
+            foreach data $datas {
+                puts "ERROR ERROR ERROR $data"
+            }
+            break
+        }
+        set status $catched
+        foreach idx [dict get $status errors] {
+            puts "ERROR ERROR ERROR [dict get $status message]"
+            puts "ERROR ERROR ERROR [lindex $datas $idx]"
+        }
+        set unused [dict get $status unused]
+        if {[llength $unused] == [llength $params]} {
+            foreach idx $unused {
+                puts "ERROR ERROR ERROR not inserted: [lindex $datas $idx]"
+            }
+            break
+        }
+        set params [lmap idx $unused {lindex $params $idx}]
+        set datas  [lmap idx $unused {lindex $datas $idx}]
     }
+    set pending_params {}
+    set pending_data   {}
 }
 
 
@@ -109,4 +157,5 @@ while {[gets stdin input] >= 0} {
     set inputs [split $input "~"] 
     insert_session $inputs 
 }
+flush_sessions
 
@@ -15,6 +15,9 @@
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 /* Define GUID type before including SQL headers */
 #ifndef GUID_DEFINED
@@ -30,20 +33,380 @@ typedef struct {
 #include <sql.h>
 #include <sqlext.h>
 
+/* Rows fetched per SQLFetch unless configured otherwise */
+#define IFX_DEFAULT_ROWSET_SIZE 256
+
+/* Upper bound on the rowset buffer memory of one result set */
+#define IFX_MAX_ROWSET_BYTES (4 * 1024 * 1024)
+
+/* Fetch buffer (FET_BUF_SIZE) the driver uses unless told otherwise, and
+ * the room a TEXT/BYTE column takes in a fetched row (its descriptor) */
+#define IFX_DEFAULT_FETCH_BUFFER 4096
+#define IFX_BLOB_DESCRIPTOR_SIZE 56
+
+/* Upper bound on the rows per SQLFetch picked by -rowsetsize auto */
+#define IFX_MAX_AUTO_ROWSET 4096
+
+/* Character columns wider than this are read with SQLGetData */
+#define IFX_MAX_BOUND_WIDTH 32768
+
+/* Most bytes a character takes in a multibyte code set (UTF-8, GB18030) */
+#define IFX_MAX_CHAR_BYTES 4
+
+/* Chunk size for reading long values with SQLGetData when the driver
+ * does not report their total length */
+#define IFX_GETDATA_CHUNK 65536
+
+/* Parameter values longer than this are sent with SQLPutData in chunks
+ * of IFX_PUTDATA_CHUNK bytes instead of being bound as one buffer */
+#define IFX_PUTDATA_THRESHOLD 32768
+#define IFX_PUTDATA_CHUNK 65536
+
+/* ifx::load reads its input in blocks of this size, and opens at most
+ * this many connections */
+#define IFX_LOAD_BLOCK 65536
+#define IFX_LOAD_MAX_CONNECTIONS 16
+
+/* ifx::export gathers formatted rows and writes them to the channel in
+ * blocks of this size */
+#define IFX_EXPORT_BLOCK (256 * 1024)
+
+/* How DATE/DATETIME/INTERVAL values are returned (-datetime) */
+enum {
+    IFX_DT_TEXT,                /* as formatted by the driver (DBDATE etc.) */
+    IFX_DT_ISO,                 /* ISO-8601 string built from the struct */
+    IFX_DT_SECONDS,             /* epoch seconds, local time like clock scan */
+    IFX_DT_MICROSECONDS         /* epoch microseconds */
+};
+
+/* Options set per connection (ifx::configure) and inherited by the
+ * statements and result sets created from it */
+typedef struct {
+    int rowset_size;            /* rows per SQLFetch (SQL_ATTR_ROW_ARRAY_SIZE),
+                                 * 0 = one fetch buffer's worth (auto) */
+    int typed;                  /* numeric columns as Tcl numbers, not strings */
+    int datetime;               /* IFX_DT_* */
+    int timeout;                /* query timeout in ms, 0 = none */
+    int max_rows;               /* rows the server returns at most, 0 = all */
+} IfxOptions;
+
+/* Informix session settings, which the driver only takes in the
+ * connection string (from odbc.ini or ifx::connect options) */
+typedef struct {
+    int fetch_buffer;           /* FBS: fetch buffer bytes, 0 = driver default */
+    int optofc;                 /* OPTOFC: open, fetch and close in one round trip */
+} IfxSession;
+
+/* Round trip accounting of a statement or result set. SQLFetch calls are
+ * counted; round trips are estimated from the fetch buffer and row width,
+ * as the driver refills its buffer from the server once per buffer of rows. */
+typedef struct {
+    Tcl_WideInt executes;
+    Tcl_WideInt fetches;        /* SQLFetch calls */
+    Tcl_WideInt rows;           /* rows read from the driver */
+    Tcl_WideInt round_trips;    /* estimated client/server round trips */
+} IfxStats;
+
+typedef struct IfxPool IfxPool;
+
 /* Connection structure */
 typedef struct {
-    SQLHENV henv;
-    SQLHDBC hdbc;
+    SQLHDBC hdbc;               /* allocated on the shared environment */
     int connected;
+    IfxOptions opts;
+    IfxSession session;
+    SQLUINTEGER getdata_ext;    /* SQL_GETDATA_EXTENSIONS of the driver */
+    IfxPool *pool;              /* pool to release to, NULL if not pooled */
+    char *conn_str;             /* connection string, to pool the hdbc or open
+                                 * more like it (ifx::load -connections) */
+    int users;                  /* open statements and direct result sets */
+    int closed;                 /* disconnected while it still had users */
 } IfxConnection;
 
+typedef struct IfxStatement IfxStatement;
+
+/* Result column: description plus its column-wise rowset buffer */
+typedef struct {
+    char *name;
+    Tcl_Obj *name_obj;          /* shared dict key for every row */
+    SQLSMALLINT sql_type;
+    SQLULEN size;
+    SQLSMALLINT digits;
+    SQLSMALLINT nullable;
+    SQLSMALLINT c_type;         /* C type the column is fetched as */
+    SQLLEN octets;              /* SQL_DESC_OCTET_LENGTH of character columns */
+    SQLLEN width;               /* bytes per row in data, 0 = not bindable */
+    SQLLEN next_width;          /* width to bind with at the next rebind */
+    char *data;                 /* rowset_size * width bytes, NULL = SQLGetData */
+    SQLLEN *ind;                /* rowset_size length/indicator values */
+    Tcl_Obj **full;             /* per row, whole value that outgrew data, or NULL */
+} IfxColumn;
+
 /* Result set structure */
 typedef struct {
     SQLHSTMT hstmt;
     SQLSMALLINT num_cols;
-    char **col_names;
+    IfxColumn *cols;
+    Tcl_Obj **row_objv;         /* num_cols slots to assemble a row list in */
+    IfxStatement *stmt;         /* owning prepared statement, NULL if hstmt is ours */
+    IfxConnection *conn;
+    IfxOptions opts;
+    SQLUINTEGER getdata_ext;
+    
+    /* Rowset state: when bound, each SQLFetch fills up to rowset_size rows
+     * into the column buffers and rows are handed out from there. Columns
+     * without a buffer (long data) are read with SQLGetData, which limits
+     * the rowset to one row. */
+    int bound;
+    int widen;                  /* a column outgrew its buffer: rebind */
+    int unbound_cols;           /* columns read with SQLGetData */
+    SQLULEN rowset_size;
+    SQLULEN rows_fetched;       /* rows in the current rowset */
+    SQLULEN next_row;           /* next row of the rowset to hand out */
+    SQLULEN cur_row;            /* row the column values are read from */
+    SQLUSMALLINT *row_status;
+    int done;                   /* SQL_NO_DATA seen */
+    Tcl_HashEntry *cancel_entry; /* in the ifx::cancel table */
+    
+    SQLLEN row_width;           /* bytes per row in the fetch buffer (estimate) */
+    int cursor_closed;          /* release_cursor has run */
+    IfxStats stats;
 } IfxResultSet;
 
+/* Prepared statement structure
+ *
+ * The hstmt stays prepared for the lifetime of the statement, so repeated
+ * executes only bind parameters and run SQLExecute. A statement has at most
+ * one open cursor; re-executing it closes the cursor of the previous result.
+ */
+struct IfxStatement {
+    SQLHSTMT hstmt;
+    IfxConnection *conn;
+    SQLSMALLINT num_params;
+    SQLSMALLINT *param_types;   /* SQL type of each parameter (SQLDescribeParam) */
+    SQLULEN *param_sizes;
+    SQLSMALLINT *param_digits;
+    SQLLEN *param_ind;          /* length/indicator, must outlive SQLExecute */
+    IfxResultSet *active;       /* result set currently using hstmt */
+    IfxOptions opts;
+    struct IfxAsyncExec *async; /* execute -async in progress */
+    Tcl_HashEntry *cancel_entry; /* in the ifx::cancel table */
+    int limits_changed;         /* -timeout/-maxrows set since the last execute */
+    IfxStats stats;             /* of all executes, including the open result */
+};
+
+/* Handles
+ *
+ * Connection, statement and result handles are named ifxconnN, ifxstmtN
+ * and ifxresultN. The names are registered in a per-interp table, and a
+ * handle object caches its table record in its internal rep, so after the
+ * first use a command resolves its handle without any string lookup. A
+ * record outlives its table entry while handle objects still refer to it;
+ * closing a handle clears its pointer, which invalidates every cached copy.
+ *
+ * Tcl interps are bound to a thread, so the tables are per thread as well.
+ * Handle numbers come from process-wide counters so that a connection
+ * moved to another thread (ifx::detach/attach) keeps a unique name.
+ */
+enum { IFX_HANDLE_CONN, IFX_HANDLE_STMT, IFX_HANDLE_RESULT };
+
+typedef struct {
+    void *ptr;                  /* IfxConnection etc., NULL once closed */
+    int kind;                   /* IFX_HANDLE_* */
+    Tcl_Interp *interp;         /* interp the handle belongs to */
+    int refs;                   /* table entry plus handle objects */
+} IfxHandle;
+
+/* Assoc data key of the per-interp handle table */
+#define IFX_HANDLE_TABLE "ifxcli"
+
+static const char *handle_prefixes[] = { "ifxconn", "ifxstmt", "ifxresult" };
+static int handle_counters[3];
+TCL_DECLARE_MUTEX(handle_mutex)
+
+static void free_handle_rep(Tcl_Obj *obj);
+static void dup_handle_rep(Tcl_Obj *src, Tcl_Obj *dup);
+
+static Tcl_ObjType ifx_handle_type = {
+    "ifxhandle",
+    free_handle_rep,
+    dup_handle_rep,
+    NULL,                       /* the string rep is never invalidated */
+    NULL                        /* only set by lookup_handle */
+};
+
+static void release_handle_record(IfxHandle *handle) {
+    if (--handle->refs == 0) {
+        ckfree((char *)handle);
+    }
+}
+
+static void free_handle_rep(Tcl_Obj *obj) {
+    release_handle_record((IfxHandle *)obj->internalRep.twoPtrValue.ptr1);
+    obj->typePtr = NULL;
+}
+
+static void dup_handle_rep(Tcl_Obj *src, Tcl_Obj *dup) {
+    IfxHandle *handle = (IfxHandle *)src->internalRep.twoPtrValue.ptr1;
+    
+    handle->refs++;
+    dup->internalRep.twoPtrValue.ptr1 = handle;
+    dup->typePtr = &ifx_handle_type;
+}
+
+/* Cache a handle record in the internal rep of obj */
+static void set_handle_rep(Tcl_Obj *obj, IfxHandle *handle) {
+    if (obj->typePtr && obj->typePtr->freeIntRepProc) {
+        obj->typePtr->freeIntRepProc(obj);
+    }
+    handle->refs++;
+    obj->internalRep.twoPtrValue.ptr1 = handle;
+    obj->internalRep.twoPtrValue.ptr2 = NULL;
+    obj->typePtr = &ifx_handle_type;
+}
+
+/* Invalidate the handles still registered when the interp is deleted */
+static void delete_handle_table(ClientData clientData, Tcl_Interp *interp) {
+    Tcl_HashTable *table = (Tcl_HashTable *)clientData;
+    Tcl_HashSearch search;
+    
+    for (Tcl_HashEntry *entry = Tcl_FirstHashEntry(table, &search); entry != NULL;
+         entry = Tcl_NextHashEntry(&search)) {
+        IfxHandle *handle = (IfxHandle *)Tcl_GetHashValue(entry);
+        handle->ptr = NULL;
+        release_handle_record(handle);
+    }
+    Tcl_DeleteHashTable(table);
+    ckfree((char *)table);
+}
+
+static Tcl_HashTable *get_handle_table(Tcl_Interp *interp) {
+    Tcl_HashTable *table;
+    
+    table = (Tcl_HashTable *)Tcl_GetAssocData(interp, IFX_HANDLE_TABLE, NULL);
+    if (!table) {
+        table = (Tcl_HashTable *)ckalloc(sizeof(Tcl_HashTable));
+        Tcl_InitHashTable(table, TCL_STRING_KEYS);
+        Tcl_SetAssocData(interp, IFX_HANDLE_TABLE, delete_handle_table, table);
+    }
+    return table;
+}
+
+/* Register ptr under name and return the handle object for it */
+static Tcl_Obj *register_handle(Tcl_Interp *interp, const char *name, int kind,
+                                void *ptr) {
+    IfxHandle *handle = (IfxHandle *)ckalloc(sizeof(IfxHandle));
+    Tcl_HashEntry *entry;
+    Tcl_Obj *obj;
+    int is_new;
+    
+    handle->ptr = ptr;
+    handle->kind = kind;
+    handle->interp = interp;
+    handle->refs = 1;
+    entry = Tcl_CreateHashEntry(get_handle_table(interp), name, &is_new);
+    Tcl_SetHashValue(entry, handle);
+    
+    obj = Tcl_NewStringObj(name, -1);
+    set_handle_rep(obj, handle);
+    return obj;
+}
+
+/* Register ptr under the next free name of its kind */
+static Tcl_Obj *new_handle(Tcl_Interp *interp, int kind, void *ptr) {
+    char name[64];
+    int id;
+    
+    Tcl_MutexLock(&handle_mutex);
+    id = ++handle_counters[kind];
+    Tcl_MutexUnlock(&handle_mutex);
+    
+    snprintf(name, sizeof(name), "%s%d", handle_prefixes[kind], id);
+    return register_handle(interp, name, kind, ptr);
+}
+
+/* Resolve a handle object of the given kind; NULL if it is not open */
+static void *lookup_handle(Tcl_Interp *interp, Tcl_Obj *obj, int kind) {
+    IfxHandle *handle;
+    Tcl_HashEntry *entry;
+    
+    if (obj->typePtr == &ifx_handle_type) {
+        handle = (IfxHandle *)obj->internalRep.twoPtrValue.ptr1;
+        if (handle->interp == interp && handle->ptr != NULL) {
+            return handle->kind == kind ? handle->ptr : NULL;
+        }
+    }
+    
+    entry = Tcl_FindHashEntry(get_handle_table(interp), Tcl_GetString(obj));
+    if (!entry) {
+        return NULL;
+    }
+    handle = (IfxHandle *)Tcl_GetHashValue(entry);
+    if (handle->kind != kind) {
+        return NULL;
+    }
+    set_handle_rep(obj, handle);
+    return handle->ptr;
+}
+
+/* Unregister a handle, returning what it referred to (NULL if not open) */
+static void *close_handle(Tcl_Interp *interp, Tcl_Obj *obj, int kind) {
+    Tcl_HashEntry *entry;
+    IfxHandle *handle;
+    void *ptr;
+    
+    entry = Tcl_FindHashEntry(get_handle_table(interp), Tcl_GetString(obj));
+    if (!entry) {
+        return NULL;
+    }
+    handle = (IfxHandle *)Tcl_GetHashValue(entry);
+    if (handle->kind != kind) {
+        return NULL;
+    }
+    ptr = handle->ptr;
+    handle->ptr = NULL;
+    Tcl_DeleteHashEntry(entry);
+    release_handle_record(handle);
+    return ptr;
+}
+
+/* Cancellation
+ *
+ * ifx::cancel has to reach a statement while the thread that owns it is
+ * blocked in SQLExecute or SQLFetch, so it is called from another thread
+ * (or, for -async executes, from the owning one). Statement and result
+ * handles therefore also register their hstmt by name in a process-wide
+ * table. An entry is removed before its hstmt is freed, under the mutex
+ * SQLCancel is called with, so a cancel never reaches a freed hstmt.
+ */
+static Tcl_HashTable cancel_table;
+static int cancel_initialized = 0;
+TCL_DECLARE_MUTEX(cancel_mutex)
+
+static Tcl_HashEntry *register_cancel(Tcl_Obj *handle, SQLHSTMT hstmt) {
+    Tcl_HashEntry *entry;
+    int is_new;
+    
+    Tcl_MutexLock(&cancel_mutex);
+    if (!cancel_initialized) {
+        Tcl_InitHashTable(&cancel_table, TCL_STRING_KEYS);
+        cancel_initialized = 1;
+    }
+    entry = Tcl_CreateHashEntry(&cancel_table, Tcl_GetString(handle), &is_new);
+    Tcl_SetHashValue(entry, hstmt);
+    Tcl_MutexUnlock(&cancel_mutex);
+    return entry;
+}
+
+static void unregister_cancel(Tcl_HashEntry **entry_ptr) {
+    if (*entry_ptr) {
+        Tcl_MutexLock(&cancel_mutex);
+        Tcl_DeleteHashEntry(*entry_ptr);
+        Tcl_MutexUnlock(&cancel_mutex);
+        *entry_ptr = NULL;
+    }
+}
+
 /* DSN configuration structure */
 typedef struct {
     char driver[512];
@@ -54,10 +417,18 @@ typedef struct {
     char protocol[64];
     char user[256];
     char password[256];
+    IfxSession session;
 } DsnConfig;
 
-/* Read DSN configuration from odbc.ini
- * 
+/* DSN registry
+ *
+ * The odbc.ini files are parsed into a process-wide registry and read
+ * again only when one of them changes (its device, inode, size or mtime
+ * differ from the last read), so a connect costs a stat per file instead
+ * of reading and parsing all of them. Each file keeps its key=value lines
+ * with the section they are in, in file order; a lookup replays them as
+ * reading the file would.
+ *
  * Respects standard ODBC environment variables:
  *   ODBCINI     - Path to user's odbc.ini file (default: ~/.odbc.ini)
  *   ODBCSYSINI  - Directory containing system odbc.ini (default: /etc)
@@ -67,121 +438,252 @@ typedef struct {
  *   2. ~/.odbc.ini
  *   3. $ODBCSYSINI/odbc.ini
  *   4. /etc/odbc.ini
+ * The first two are the user files, the others the system files.
  */
-static int read_odbc_ini(const char *dsn, DsnConfig *config) {
-    FILE *fp;
-    char ini_paths[4][512];
-    int num_paths = 0;
+#define IFX_INI_FILES 4
+#define IFX_INI_USER_FILES 2
+
+typedef struct {
+    int section;                /* index into the file's sections */
+    char *key;
+    char *value;
+} IfxIniEntry;
+
+typedef struct {
+    char path[512];             /* "" if not configured */
+    int exists;                 /* read successfully */
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    char **sections;
+    int num_sections;
+    IfxIniEntry *entries;
+    int num_entries;
+} IfxIniFile;
+
+static IfxIniFile ini_files[IFX_INI_FILES];
+static int ini_exit_handler = 0;
+TCL_DECLARE_MUTEX(dsn_mutex)
+
+static void free_ini_file(IfxIniFile *file) {
+    for (int i = 0; i < file->num_sections; i++) {
+        ckfree(file->sections[i]);
+    }
+    for (int i = 0; i < file->num_entries; i++) {
+        ckfree(file->entries[i].key);
+        ckfree(file->entries[i].value);
+    }
+    if (file->sections) {
+        ckfree((char *)file->sections);
+    }
+    if (file->entries) {
+        ckfree((char *)file->entries);
+    }
+    file->sections = NULL;
+    file->num_sections = 0;
+    file->entries = NULL;
+    file->num_entries = 0;
+    file->exists = 0;
+}
+
+static void free_dsn_registry(ClientData clientData) {
+    Tcl_MutexLock(&dsn_mutex);
+    for (int i = 0; i < IFX_INI_FILES; i++) {
+        free_ini_file(&ini_files[i]);
+    }
+    Tcl_MutexUnlock(&dsn_mutex);
+}
+
+static char *copy_string(const char *text) {
+    char *copy = ckalloc(strlen(text) + 1);
+    strcpy(copy, text);
+    return copy;
+}
+
+/* Parse the sections and key=value lines of an odbc.ini file */
+static void parse_ini_file(IfxIniFile *file, FILE *fp) {
     char line[1024];
-    int in_section = 0;
-    int found = 0;
+    int section = -1;
+    int entries_size = 0;
     
-    /* Initialize config */
-    memset(config, 0, sizeof(DsnConfig));
-    
-    /* Build list of odbc.ini paths to try */
+    while (fgets(line, sizeof(line), fp)) {
+        char *p = line;
+        
+        /* Trim whitespace */
+        while (*p == ' ' || *p == '\t') p++;
+        
+        /* Skip comments and empty lines */
+        if (*p == '#' || *p == ';' || *p == '\n' || *p == '\0') continue;
+        
+        /* Check for section header */
+        if (*p == '[') {
+            char name[256];
+            if (sscanf(p, "[%255[^]]]", name) == 1) {
+                file->sections = (char **)ckrealloc((char *)file->sections,
+                    (file->num_sections + 1) * sizeof(char *));
+                file->sections[file->num_sections] = copy_string(name);
+                section = file->num_sections++;
+            }
+            continue;
+        }
+        
+        /* Keep key=value lines inside a section */
+        if (section >= 0) {
+            char key[256], value[512];
+            char *eq = strchr(p, '=');
+            if (eq) {
+                *eq = '\0';
+                
+                /* Copy key and trim */
+                strncpy(key, p, sizeof(key)-1);
+                key[sizeof(key)-1] = '\0';
+                char *k = key + strlen(key) - 1;
+                while (k >= key && (*k == ' ' || *k == '\t')) *k-- = '\0';
+                
+                /* Copy value and trim */
+                strncpy(value, eq+1, sizeof(value)-1);
+                value[sizeof(value)-1] = '\0';
+                char *v = value;
+                while (*v == ' ' || *v == '\t') v++;
+                char *vend = v + strlen(v) - 1;
+                while (vend >= v && (*vend == ' ' || *vend == '\t' || *vend == '\n')) *vend-- = '\0';
+                
+                if (file->num_entries == entries_size) {
+                    entries_size = entries_size ? 2 * entries_size : 32;
+                    file->entries = (IfxIniEntry *)ckrealloc((char *)file->entries,
+                        entries_size * sizeof(IfxIniEntry));
+                }
+                file->entries[file->num_entries].section = section;
+                file->entries[file->num_entries].key = copy_string(key);
+                file->entries[file->num_entries].value = copy_string(v);
+                file->num_entries++;
+            }
+        }
+    }
+}
+
+/* Bring the registry up to date with the odbc.ini files. Caller holds
+ * dsn_mutex. */
+static void refresh_dsn_registry(void) {
+    char paths[IFX_INI_FILES][512] = { "", "", "", "" };
     
     /* 1. ODBCINI environment variable (highest priority) */
     const char *odbcini = getenv("ODBCINI");
     if (odbcini && odbcini[0]) {
-        snprintf(ini_paths[num_paths++], sizeof(ini_paths[0]), "%s", odbcini);
+        snprintf(paths[0], sizeof(paths[0]), "%s", odbcini);
     }
     
     /* 2. User's home directory */
     const char *home = getenv("HOME");
     if (home && home[0]) {
-        snprintf(ini_paths[num_paths++], sizeof(ini_paths[0]), "%s/.odbc.ini", home);
+        snprintf(paths[1], sizeof(paths[1]), "%s/.odbc.ini", home);
     }
     
     /* 3. ODBCSYSINI directory */
     const char *odbcsysini = getenv("ODBCSYSINI");
     if (odbcsysini && odbcsysini[0]) {
-        snprintf(ini_paths[num_paths++], sizeof(ini_paths[0]), "%s/odbc.ini", odbcsysini);
+        snprintf(paths[2], sizeof(paths[2]), "%s/odbc.ini", odbcsysini);
     }
     
     /* 4. Default system location */
-    snprintf(ini_paths[num_paths++], sizeof(ini_paths[0]), "/etc/odbc.ini");
+    snprintf(paths[3], sizeof(paths[3]), "/etc/odbc.ini");
+    
+    if (!ini_exit_handler) {
+        Tcl_CreateExitHandler(free_dsn_registry, NULL);
+        ini_exit_handler = 1;
+    }
     
-    /* Try each ini file */
-    for (int i = 0; i < num_paths; i++) {
-        fp = fopen(ini_paths[i], "r");
+    for (int i = 0; i < IFX_INI_FILES; i++) {
+        IfxIniFile *file = &ini_files[i];
+        struct stat st;
+        FILE *fp;
+        
+        if (!paths[i][0] || stat(paths[i], &st) != 0) {
+            free_ini_file(file);
+            file->path[0] = '\0';
+            continue;
+        }
+        if (file->exists && strcmp(file->path, paths[i]) == 0
+                && file->dev == st.st_dev && file->ino == st.st_ino
+                && file->size == st.st_size && file->mtime == st.st_mtime) {
+            continue;
+        }
+        
+        free_ini_file(file);
+        memcpy(file->path, paths[i], sizeof(file->path));
+        fp = fopen(paths[i], "r");
         if (!fp) continue;
+        parse_ini_file(file, fp);
+        fclose(fp);
+        file->exists = 1;
+        file->dev = st.st_dev;
+        file->ino = st.st_ino;
+        file->size = st.st_size;
+        file->mtime = st.st_mtime;
+    }
+}
+
+/* Read DSN configuration from odbc.ini (the DSN registry). Returns 1 if a
+ * file has a Driver for the DSN; the files are searched in order and the
+ * settings of earlier files without one carry over. */
+static int read_odbc_ini(const char *dsn, DsnConfig *config) {
+    int found = 0;
+    
+    /* Initialize config */
+    memset(config, 0, sizeof(DsnConfig));
+    
+    Tcl_MutexLock(&dsn_mutex);
+    refresh_dsn_registry();
+    
+    for (int i = 0; i < IFX_INI_FILES && !found; i++) {
+        IfxIniFile *file = &ini_files[i];
         
-        in_section = 0;
-        while (fgets(line, sizeof(line), fp)) {
-            char *p = line;
+        for (int e = 0; e < file->num_entries; e++) {
+            const char *key = file->entries[e].key;
+            const char *v = file->entries[e].value;
             
-            /* Trim whitespace */
-            while (*p == ' ' || *p == '\t') p++;
-            
-            /* Skip comments and empty lines */
-            if (*p == '#' || *p == ';' || *p == '\n' || *p == '\0') continue;
-            
-            /* Check for section header */
-            if (*p == '[') {
-                char section[256];
-                if (sscanf(p, "[%255[^]]]", section) == 1) {
-                    in_section = (strcmp(section, dsn) == 0);
-                }
+            if (strcmp(file->sections[file->entries[e].section], dsn) != 0) {
                 continue;
             }
             
-            /* Parse key=value in our section */
-            if (in_section) {
-                char key[256], value[512];
-                char *eq = strchr(p, '=');
-                if (eq) {
-                    *eq = '\0';
-                    
-                    /* Copy key and trim */
-                    strncpy(key, p, sizeof(key)-1);
-                    key[sizeof(key)-1] = '\0';
-                    char *k = key + strlen(key) - 1;
-                    while (k >= key && (*k == ' ' || *k == '\t')) *k-- = '\0';
-                    
-                    /* Copy value and trim */
-                    strncpy(value, eq+1, sizeof(value)-1);
-                    value[sizeof(value)-1] = '\0';
-                    char *v = value;
-                    while (*v == ' ' || *v == '\t') v++;
-                    char *vend = v + strlen(v) - 1;
-                    while (vend >= v && (*vend == ' ' || *vend == '\t' || *vend == '\n')) *vend-- = '\0';
-                    
-                    /* Store values */
-                    if (strcasecmp(key, "driver") == 0) {
-                        snprintf(config->driver, sizeof(config->driver), "%s", v);
-                        found = 1;
-                    }
-                    else if (strcasecmp(key, "database") == 0) {
-                        snprintf(config->database, sizeof(config->database), "%s", v);
-                    }
-                    else if (strcasecmp(key, "server") == 0 || strcasecmp(key, "servername") == 0) {
-                        snprintf(config->server, sizeof(config->server), "%s", v);
-                    }
-                    else if (strcasecmp(key, "host") == 0) {
-                        snprintf(config->host, sizeof(config->host), "%s", v);
-                    }
-                    else if (strcasecmp(key, "service") == 0 || strcasecmp(key, "port") == 0) {
-                        snprintf(config->service, sizeof(config->service), "%s", v);
-                    }
-                    else if (strcasecmp(key, "protocol") == 0) {
-                        snprintf(config->protocol, sizeof(config->protocol), "%s", v);
-                    }
-                    else if (strcasecmp(key, "uid") == 0 || strcasecmp(key, "logonid") == 0) {
-                        snprintf(config->user, sizeof(config->user), "%s", v);
-                    }
-                    else if (strcasecmp(key, "pwd") == 0 || strcasecmp(key, "password") == 0) {
-                        snprintf(config->password, sizeof(config->password), "%s", v);
-                    }
-                }
+            /* Store values */
+            if (strcasecmp(key, "driver") == 0) {
+                snprintf(config->driver, sizeof(config->driver), "%s", v);
+                found = 1;
+            }
+            else if (strcasecmp(key, "database") == 0) {
+                snprintf(config->database, sizeof(config->database), "%s", v);
+            }
+            else if (strcasecmp(key, "server") == 0 || strcasecmp(key, "servername") == 0) {
+                snprintf(config->server, sizeof(config->server), "%s", v);
+            }
+            else if (strcasecmp(key, "host") == 0) {
+                snprintf(config->host, sizeof(config->host), "%s", v);
+            }
+            else if (strcasecmp(key, "service") == 0 || strcasecmp(key, "port") == 0) {
+                snprintf(config->service, sizeof(config->service), "%s", v);
+            }
+            else if (strcasecmp(key, "protocol") == 0) {
+                snprintf(config->protocol, sizeof(config->protocol), "%s", v);
+            }
+            else if (strcasecmp(key, "uid") == 0 || strcasecmp(key, "logonid") == 0) {
+                snprintf(config->user, sizeof(config->user), "%s", v);
+            }
+            else if (strcasecmp(key, "pwd") == 0 || strcasecmp(key, "password") == 0) {
+                snprintf(config->password, sizeof(config->password), "%s", v);
+            }
+            else if (strcasecmp(key, "fbs") == 0 || strcasecmp(key, "fetchbuffersize") == 0) {
+                config->session.fetch_buffer = atoi(v);
+            }
+            else if (strcasecmp(key, "optofc") == 0) {
+                config->session.optofc = atoi(v) != 0;
             }
         }
-        
-        fclose(fp);
-        if (found) return 1;
     }
+    Tcl_MutexUnlock(&dsn_mutex);
     
-    return 0;
+    return found;
 }
 
 /* Build connection string from DSN config */
@@ -224,75 +726,124 @@ static void build_connection_string(const DsnConfig *config, const char *dsn,
     } else if (config->password[0]) {
         len += snprintf(conn_str + len, bufsize - len, "PWD=%s;", config->password);
     }
+    
+    /* Add session settings */
+    if (config->session.fetch_buffer > 0) {
+        len += snprintf(conn_str + len, bufsize - len, "FBS=%d;", config->session.fetch_buffer);
+    }
+    if (config->session.optofc) {
+        len += snprintf(conn_str + len, bufsize - len, "OPTOFC=1;");
+    }
 }
 
-/* ifx::connect dsn ?user? ?password? */
-static int IfxConnect_Cmd(ClientData clientData, Tcl_Interp *interp, 
-                          int objc, Tcl_Obj *CONST objv[]) {
-    IfxConnection *conn;
-    SQLRETURN ret;
-    char *dsn, *user = "", *password = "";
+/* One ODBC environment shared by all connections of the process. It is
+ * allocated on first use and freed at exit. */
+static SQLHENV shared_henv = SQL_NULL_HENV;
+TCL_DECLARE_MUTEX(env_mutex)
+
+static void free_shared_env(ClientData clientData);
+
+static SQLHENV get_shared_env(void) {
+    Tcl_MutexLock(&env_mutex);
+    if (shared_henv == SQL_NULL_HENV) {
+        if (SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &shared_henv) == SQL_SUCCESS) {
+            SQLSetEnvAttr(shared_henv, SQL_ATTR_ODBC_VERSION, (SQLPOINTER)SQL_OV_ODBC3, 0);
+            Tcl_CreateExitHandler(free_shared_env, NULL);
+        } else {
+            shared_henv = SQL_NULL_HENV;
+        }
+    }
+    Tcl_MutexUnlock(&env_mutex);
+    return shared_henv;
+}
+
+/* Options of ifx::connect and ifx::pool acquire, after dsn ?user? ?password? */
+static const char *connect_options[] = { "-fetchbuffer", "-optofc", NULL };
+
+/* Build the full connection string from dsn ?user? ?password? ?-option value ...?
+ * arguments, and the session settings it makes */
+static int connect_string(Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[],
+                          char *conn_str, int bufsize, IfxSession *session) {
+    const char *login[3] = { "", "", "" };
     DsnConfig config;
-    char conn_str[2048];
-    SQLCHAR out_conn_str[1024];
-    SQLSMALLINT out_conn_len;
-    char conn_name[64];
-    static int conn_counter = 0;
+    int nlogin = 0, i;
     
-    if (objc < 2 || objc > 4) {
-        Tcl_WrongNumArgs(interp, 1, objv, "dsn ?user? ?password?");
-        return TCL_ERROR;
+    /* Login arguments end at the first option */
+    for (i = 0; i < objc && nlogin < 3; i++) {
+        int index;
+        if (i > 0 && Tcl_GetIndexFromObj(NULL, objv[i], connect_options, "option",
+                                         TCL_EXACT, &index) == TCL_OK) {
+            break;
+        }
+        login[nlogin++] = Tcl_GetString(objv[i]);
     }
     
-    dsn = Tcl_GetString(objv[1]);
-    
     /* Read DSN configuration from odbc.ini */
-    if (!read_odbc_ini(dsn, &config)) {
+    if (!read_odbc_ini(login[0], &config)) {
         /* DSN not found, use minimal connection string */
         memset(&config, 0, sizeof(config));
     }
     
-    /* Get user/password from arguments if provided */
-    if (objc >= 3) {
-        user = Tcl_GetString(objv[2]);
-    }
-    if (objc >= 4) {
-        password = Tcl_GetString(objv[3]);
+    for (; i < objc; i += 2) {
+        int index, value;
+        
+        if (Tcl_GetIndexFromObj(interp, objv[i], connect_options, "option", 0,
+                                &index) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (i + 1 == objc) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf("missing value for %s",
+                                                   connect_options[index]));
+            return TCL_ERROR;
+        }
+        if (index == 0) {
+            if (Tcl_GetIntFromObj(interp, objv[i+1], &value) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            if (value < 0) {
+                Tcl_SetResult(interp, "-fetchbuffer must be >= 0", TCL_STATIC);
+                return TCL_ERROR;
+            }
+            config.session.fetch_buffer = value;
+        } else {
+            if (Tcl_GetBooleanFromObj(interp, objv[i+1], &value) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            config.session.optofc = value;
+        }
     }
     
-    /* Build full connection string */
-    build_connection_string(&config, dsn, user, password, conn_str, sizeof(conn_str));
-    
-    /* Allocate connection structure */
-    conn = (IfxConnection *)ckalloc(sizeof(IfxConnection));
-    conn->connected = 0;
+    build_connection_string(&config, login[0], login[1], login[2], conn_str, bufsize);
+    *session = config.session;
+    return TCL_OK;
+}
+
+/* Allocate a connection handle on the shared environment and connect it */
+static int driver_connect(Tcl_Interp *interp, const char *conn_str, SQLHDBC *hdbc_ptr) {
+    SQLHENV henv = get_shared_env();
+    SQLHDBC hdbc;
+    SQLRETURN ret;
+    SQLCHAR out_conn_str[1024];
+    SQLSMALLINT out_conn_len;
     
-    /* Allocate environment handle */
-    ret = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &conn->henv);
-    if (ret != SQL_SUCCESS) {
-        ckfree((char *)conn);
+    if (henv == SQL_NULL_HENV) {
         Tcl_SetResult(interp, "Failed to allocate environment handle", TCL_STATIC);
         return TCL_ERROR;
     }
     
-    /* Set ODBC version */
-    SQLSetEnvAttr(conn->henv, SQL_ATTR_ODBC_VERSION, (SQLPOINTER)SQL_OV_ODBC3, 0);
-    
     /* Allocate connection handle */
-    ret = SQLAllocHandle(SQL_HANDLE_DBC, conn->henv, &conn->hdbc);
+    ret = SQLAllocHandle(SQL_HANDLE_DBC, henv, &hdbc);
     if (ret != SQL_SUCCESS) {
-        SQLFreeHandle(SQL_HANDLE_ENV, conn->henv);
-        ckfree((char *)conn);
         Tcl_SetResult(interp, "Failed to allocate connection handle", TCL_STATIC);
         return TCL_ERROR;
     }
     
     /* Set connection timeout to avoid infinite hangs */
-    SQLSetConnectAttr(conn->hdbc, SQL_ATTR_CONNECTION_TIMEOUT, (SQLPOINTER)30, 0);
-    SQLSetConnectAttr(conn->hdbc, SQL_ATTR_LOGIN_TIMEOUT, (SQLPOINTER)30, 0);
+    SQLSetConnectAttr(hdbc, SQL_ATTR_CONNECTION_TIMEOUT, (SQLPOINTER)30, 0);
+    SQLSetConnectAttr(hdbc, SQL_ATTR_LOGIN_TIMEOUT, (SQLPOINTER)30, 0);
     
     /* Connect using SQLDriverConnect with full connection string */
-    ret = SQLDriverConnect(conn->hdbc, NULL,
+    ret = SQLDriverConnect(hdbc, NULL,
                            (SQLCHAR *)conn_str, SQL_NTS,
                            out_conn_str, sizeof(out_conn_str),
                            &out_conn_len, SQL_DRIVER_NOPROMPT);
@@ -304,182 +855,4984 @@ static int IfxConnect_Cmd(ClientData clientData, Tcl_Interp *interp,
         SQLSMALLINT errmsg_len;
         char error_buf[1200];
         
-        SQLGetDiagRec(SQL_HANDLE_DBC, conn->hdbc, 1, 
+        SQLGetDiagRec(SQL_HANDLE_DBC, hdbc, 1, 
                       sqlstate, &native_error, errmsg, sizeof(errmsg), &errmsg_len);
         
         snprintf(error_buf, sizeof(error_buf), 
                  "Failed to connect: [%s] %s", sqlstate, errmsg);
         
-        SQLFreeHandle(SQL_HANDLE_DBC, conn->hdbc);
-        SQLFreeHandle(SQL_HANDLE_ENV, conn->henv);
-        ckfree((char *)conn);
+        SQLFreeHandle(SQL_HANDLE_DBC, hdbc);
         Tcl_SetResult(interp, error_buf, TCL_VOLATILE);
         return TCL_ERROR;
     }
     
-    conn->connected = 1;
+    *hdbc_ptr = hdbc;
+    return TCL_OK;
+}
+
+/* Wrap a connected hdbc in a connection */
+static IfxConnection *alloc_connection(SQLHDBC hdbc, const IfxSession *session) {
+    IfxConnection *conn;
     
-    /* Create connection handle name */
-    snprintf(conn_name, sizeof(conn_name), "ifxconn%d", ++conn_counter);
+    conn = (IfxConnection *)ckalloc(sizeof(IfxConnection));
+    conn->hdbc = hdbc;
+    conn->connected = 1;
+    conn->pool = NULL;
+    conn->conn_str = NULL;
+    conn->users = 0;
+    conn->closed = 0;
+    conn->session = *session;
+    conn->opts.rowset_size = IFX_DEFAULT_ROWSET_SIZE;
+    conn->opts.typed = 0;
+    conn->opts.datetime = IFX_DT_TEXT;
+    conn->opts.timeout = 0;
+    conn->opts.max_rows = 0;
     
-    /* Store connection in interpreter */
-    Tcl_SetAssocData(interp, conn_name, NULL, (ClientData)conn);
+    /* Which columns SQLGetData may read next to bound ones */
+    conn->getdata_ext = 0;
+    SQLGetInfo(conn->hdbc, SQL_GETDATA_EXTENSIONS, &conn->getdata_ext,
+               sizeof(conn->getdata_ext), NULL);
+    return conn;
+}
+
+/* Wrap a connected hdbc in a connection and register its handle as the
+ * interp result */
+static IfxConnection *new_connection(Tcl_Interp *interp, SQLHDBC hdbc,
+                                     const IfxSession *session) {
+    IfxConnection *conn = alloc_connection(hdbc, session);
     
-    Tcl_SetResult(interp, conn_name, TCL_VOLATILE);
-    return TCL_OK;
+    Tcl_SetObjResult(interp, new_handle(interp, IFX_HANDLE_CONN, conn));
+    return conn;
 }
 
-/* ifx::execute conn_handle sql ?param1 param2 ...? */
-static int IfxExecute_Cmd(ClientData clientData, Tcl_Interp *interp,
+/* ifx::connect dsn ?user? ?password? ?-fetchbuffer bytes? ?-optofc bool?
+ *
+ * -fetchbuffer sets the Informix fetch buffer (FET_BUF_SIZE) of the
+ * session: rows travel from the server one buffer at a time, so wide scans
+ * over slow links want a large one. -optofc defers a cursor's open to its
+ * first fetch and closes it with the last one, saving two round trips per
+ * query. Both override FetchBufferSize/OPTOFC in odbc.ini.
+ */
+static int IfxConnect_Cmd(ClientData clientData, Tcl_Interp *interp, 
                           int objc, Tcl_Obj *CONST objv[]) {
+    char conn_str[2048];
+    IfxSession session;
     IfxConnection *conn;
-    IfxResultSet *result;
-    SQLHSTMT hstmt;
-    SQLRETURN ret;
-    char *conn_name, *sql;
-    char result_name[64];
-    static int result_counter = 0;
+    SQLHDBC hdbc;
     
-    if (objc < 3) {
-        Tcl_WrongNumArgs(interp, 1, objv, "conn_handle sql ?params?");
+    if (objc < 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "dsn ?user? ?password? ?-option value ...?");
         return TCL_ERROR;
     }
     
-    conn_name = Tcl_GetString(objv[1]);
-    sql = Tcl_GetString(objv[2]);
-    
-    /* Get connection */
-    conn = (IfxConnection *)Tcl_GetAssocData(interp, conn_name, NULL);
-    if (!conn || !conn->connected) {
-        Tcl_SetResult(interp, "Invalid connection handle", TCL_STATIC);
+    if (connect_string(interp, objc - 1, objv + 1, conn_str, sizeof(conn_str),
+                       &session) != TCL_OK) {
         return TCL_ERROR;
     }
     
-    /* Allocate statement handle */
-    ret = SQLAllocHandle(SQL_HANDLE_STMT, conn->hdbc, &hstmt);
-    if (ret != SQL_SUCCESS) {
-        Tcl_SetResult(interp, "Failed to allocate statement handle", TCL_STATIC);
+    if (driver_connect(interp, conn_str, &hdbc) != TCL_OK) {
         return TCL_ERROR;
     }
     
-    /* Execute SQL */
-    ret = SQLExecDirect(hstmt, (SQLCHAR *)sql, SQL_NTS);
-    /* SQL_NO_DATA (100) is returned for DELETE/UPDATE that affect 0 rows - not an error */
-    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO && ret != SQL_NO_DATA) {
-        /* Get detailed error message from the database */
-        SQLCHAR sqlstate[6] = "00000";
-        SQLCHAR errmsg[1024] = "";
-        SQLINTEGER native_error = 0;
-        SQLSMALLINT errmsg_len = 0;
-        char error_buf[1200];
-        SQLRETURN diag_ret;
-        
-        diag_ret = SQLGetDiagRec(SQL_HANDLE_STMT, hstmt, 1, 
-                      sqlstate, &native_error, errmsg, sizeof(errmsg), &errmsg_len);
-        
-        if (diag_ret == SQL_SUCCESS || diag_ret == SQL_SUCCESS_WITH_INFO) {
-            snprintf(error_buf, sizeof(error_buf), 
-                     "SQL error [%s] (%d): %s", sqlstate, (int)native_error, errmsg);
-        } else {
-            snprintf(error_buf, sizeof(error_buf), 
-                     "SQL execution failed (ret=%d, no diagnostic available)", (int)ret);
-        }
-        
-        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
-        Tcl_SetResult(interp, error_buf, TCL_VOLATILE);
-        return TCL_ERROR;
+    conn = new_connection(interp, hdbc, &session);
+    conn->conn_str = ckalloc(strlen(conn_str) + 1);
+    strcpy(conn->conn_str, conn_str);
+    return TCL_OK;
+}
+
+/* Connection pools
+ *
+ * A pool keeps up to max_idle connected hdbcs that were released, keyed by
+ * their connection string, for ifx::pool acquire to hand out again without
+ * a new login. Pools are process-wide and named. Idle connections are
+ * checked with SQL_ATTR_CONNECTION_DEAD before reuse, and those idle for
+ * longer than idle_timeout seconds are disconnected whenever the pool is
+ * used or reaped.
+ */
+#define IFX_POOL_MAX_IDLE 8
+#define IFX_POOL_IDLE_TIMEOUT 300
+
+typedef struct IfxIdleDbc {
+    char *conn_str;
+    SQLHDBC hdbc;
+    time_t idle_since;
+    struct IfxIdleDbc *next;
+} IfxIdleDbc;
+
+struct IfxPool {
+    int max_idle;
+    int idle_timeout;           /* seconds, 0 = never reap */
+    int idle_count;
+    IfxIdleDbc *idle;           /* most recently released first */
+    int active;                 /* connections handed out and not released */
+    int deleted;                /* destroyed while connections were active */
+    Tcl_WideInt hits, misses, dead, reaped;
+};
+
+static Tcl_HashTable pools;
+static int pools_initialized = 0;
+TCL_DECLARE_MUTEX(pool_mutex)
+
+static void close_dbc(SQLHDBC hdbc) {
+    SQLDisconnect(hdbc);
+    SQLFreeHandle(SQL_HANDLE_DBC, hdbc);
+}
+
+/* Unlink and return the idle entries of a pool released at or before
+ * older_than, counting them in *counter if given. The caller disconnects
+ * them with close_idle outside the pool lock. */
+static IfxIdleDbc *take_idle(IfxPool *pool, time_t older_than, Tcl_WideInt *counter) {
+    IfxIdleDbc **link = &pool->idle;
+    IfxIdleDbc *taken = NULL;
+    
+    while (*link) {
+        IfxIdleDbc *entry = *link;
+        if (entry->idle_since <= older_than) {
+            *link = entry->next;
+            entry->next = taken;
+            taken = entry;
+            pool->idle_count--;
+            if (counter) {
+                (*counter)++;
+            }
+        } else {
+            link = &entry->next;
+        }
+    }
+    return taken;
+}
+
+static void close_idle(IfxIdleDbc *list) {
+    while (list) {
+        IfxIdleDbc *next = list->next;
+        close_dbc(list->hdbc);
+        ckfree(list->conn_str);
+        ckfree((char *)list);
+        list = next;
+    }
+}
+
+/* Idle entries past the pool's idle timeout; call with pool_mutex held */
+static IfxIdleDbc *take_expired(IfxPool *pool) {
+    if (pool->idle_timeout <= 0) {
+        return NULL;
+    }
+    return take_idle(pool, time(NULL) - pool->idle_timeout, &pool->reaped);
+}
+
+/* Look up a pool by name; call with pool_mutex held */
+static IfxPool *find_pool(Tcl_Interp *interp, Tcl_Obj *name) {
+    Tcl_HashEntry *entry = NULL;
+    
+    if (pools_initialized) {
+        entry = Tcl_FindHashEntry(&pools, Tcl_GetString(name));
+    }
+    if (!entry) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("no pool named \"%s\"", Tcl_GetString(name)));
+        return NULL;
+    }
+    return (IfxPool *)Tcl_GetHashValue(entry);
+}
+
+/* Undo what the last user of a connection left behind before its hdbc is
+ * pooled: a transaction under manual commit, one opened with BEGIN WORK
+ * (which SQLEndTran does not end) and autocommit turned off. Returns 0 if
+ * the hdbc is not fit for reuse. */
+static int reset_session(SQLHDBC hdbc) {
+    SQLHSTMT hstmt;
+    SQLRETURN ret;
+    
+    ret = SQLEndTran(SQL_HANDLE_DBC, hdbc, SQL_ROLLBACK);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        return 0;
+    }
+    
+    if (SQLAllocHandle(SQL_HANDLE_STMT, hdbc, &hstmt) != SQL_SUCCESS) {
+        return 0;
+    }
+    ret = SQLExecDirect(hstmt, (SQLCHAR *)"ROLLBACK WORK", SQL_NTS);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        SQLCHAR sqlstate[6];
+        SQLINTEGER native_error = 0;
+        
+        /* -255 "Not in transaction" is the usual case, -256 "Transaction
+         * not available" that of a database without logging */
+        if (SQLGetDiagRec(SQL_HANDLE_STMT, hstmt, 1, sqlstate, &native_error,
+                          NULL, 0, NULL) == SQL_NO_DATA ||
+            (native_error != -255 && native_error != -256)) {
+            SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+            return 0;
+        }
+    }
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    
+    ret = SQLSetConnectAttr(hdbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_ON, 0);
+    return ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO;
+}
+
+/* Disconnect a connection, or hand its hdbc back to the pool it came from
+ * with any open transaction rolled back (see reset_session), and free
+ * conn. If statements or result sets are still open, their hstmts must go
+ * before the hdbc: conn is only marked closed, and the close of the last
+ * of them releases it. */
+static void release_connection(IfxConnection *conn) {
+    IfxPool *pool = conn->pool;
+    IfxIdleDbc *expired = NULL;
+    int keep = 0;
+    
+    if (conn->users > 0) {
+        conn->closed = 1;
+        return;
+    }
+    
+    if (pool) {
+        if (conn->connected) {
+            keep = reset_session(conn->hdbc);
+        }
+        
+        Tcl_MutexLock(&pool_mutex);
+        pool->active--;
+        if (keep && !pool->deleted && pool->idle_count < pool->max_idle) {
+            IfxIdleDbc *entry = (IfxIdleDbc *)ckalloc(sizeof(IfxIdleDbc));
+            entry->conn_str = conn->conn_str;
+            entry->hdbc = conn->hdbc;
+            entry->idle_since = time(NULL);
+            entry->next = pool->idle;
+            pool->idle = entry;
+            pool->idle_count++;
+            conn->conn_str = NULL;
+            conn->connected = 0;
+            conn->hdbc = SQL_NULL_HDBC;
+        }
+        expired = take_expired(pool);
+        if (pool->deleted && pool->active == 0) {
+            ckfree((char *)pool);
+        }
+        Tcl_MutexUnlock(&pool_mutex);
+        close_idle(expired);
+    }
+    
+    if (conn->hdbc != SQL_NULL_HDBC) {
+        if (conn->connected) {
+            SQLDisconnect(conn->hdbc);
+        }
+        SQLFreeHandle(SQL_HANDLE_DBC, conn->hdbc);
+        conn->hdbc = SQL_NULL_HDBC;
+        conn->connected = 0;
+    }
+    if (conn->conn_str) {
+        ckfree(conn->conn_str);
+        conn->conn_str = NULL;
+    }
+    ckfree((char *)conn);
+}
+
+/* A statement or direct result set of conn was closed, after freeing its
+ * hstmt */
+static void drop_connection_user(IfxConnection *conn) {
+    if (--conn->users == 0 && conn->closed) {
+        release_connection(conn);
+    }
+}
+
+static void free_shared_env(ClientData clientData) {
+    Tcl_HashSearch search;
+    
+    Tcl_MutexLock(&pool_mutex);
+    if (pools_initialized) {
+        for (Tcl_HashEntry *entry = Tcl_FirstHashEntry(&pools, &search); entry != NULL;
+             entry = Tcl_NextHashEntry(&search)) {
+            IfxPool *pool = (IfxPool *)Tcl_GetHashValue(entry);
+            close_idle(take_idle(pool, time(NULL), NULL));
+        }
+    }
+    Tcl_MutexUnlock(&pool_mutex);
+    
+    Tcl_MutexLock(&env_mutex);
+    if (shared_henv != SQL_NULL_HENV) {
+        SQLFreeHandle(SQL_HANDLE_ENV, shared_henv);
+        shared_henv = SQL_NULL_HENV;
+    }
+    Tcl_MutexUnlock(&env_mutex);
+}
+
+/* ifx::pool acquire name dsn ?user? ?password? ?-option value ...?
+ *
+ * Returns a connection handle, reusing an idle connection of the pool made
+ * with the same connection string if there is a live one. Takes the
+ * options of ifx::connect. */
+static int pool_acquire(Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]) {
+    IfxPool *pool;
+    IfxIdleDbc *expired, *reused = NULL;
+    IfxConnection *conn;
+    char conn_str[2048];
+    IfxSession session;
+    SQLHDBC hdbc;
+    
+    if (objc < 4) {
+        Tcl_WrongNumArgs(interp, 2, objv, "name dsn ?user? ?password? ?-option value ...?");
+        return TCL_ERROR;
+    }
+    
+    if (connect_string(interp, objc - 3, objv + 3, conn_str, sizeof(conn_str),
+                       &session) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    
+    Tcl_MutexLock(&pool_mutex);
+    pool = find_pool(interp, objv[2]);
+    if (!pool) {
+        Tcl_MutexUnlock(&pool_mutex);
+        return TCL_ERROR;
+    }
+    /* Counted as active from here on, so a destroy can't free the pool */
+    pool->active++;
+    expired = take_expired(pool);
+    
+    while (1) {
+        IfxIdleDbc **link = &pool->idle;
+        SQLUINTEGER dead = SQL_CD_FALSE;
+        SQLRETURN ret;
+        
+        while (*link && strcmp((*link)->conn_str, conn_str) != 0) {
+            link = &(*link)->next;
+        }
+        reused = *link;
+        if (!reused) {
+            pool->misses++;
+            break;
+        }
+        *link = reused->next;
+        pool->idle_count--;
+        Tcl_MutexUnlock(&pool_mutex);
+        
+        ret = SQLGetConnectAttr(reused->hdbc, SQL_ATTR_CONNECTION_DEAD, &dead, 0, NULL);
+        
+        Tcl_MutexLock(&pool_mutex);
+        if ((ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) && dead == SQL_CD_TRUE) {
+            pool->dead++;
+            reused->next = expired;
+            expired = reused;
+            continue;
+        }
+        pool->hits++;
+        break;
+    }
+    Tcl_MutexUnlock(&pool_mutex);
+    close_idle(expired);
+    
+    if (reused) {
+        hdbc = reused->hdbc;
+    } else if (driver_connect(interp, conn_str, &hdbc) != TCL_OK) {
+        Tcl_MutexLock(&pool_mutex);
+        pool->active--;
+        if (pool->deleted && pool->active == 0) {
+            ckfree((char *)pool);
+        }
+        Tcl_MutexUnlock(&pool_mutex);
+        return TCL_ERROR;
+    }
+    
+    conn = new_connection(interp, hdbc, &session);
+    conn->pool = pool;
+    if (reused) {
+        conn->conn_str = reused->conn_str;
+        ckfree((char *)reused);
+    } else {
+        conn->conn_str = ckalloc(strlen(conn_str) + 1);
+        strcpy(conn->conn_str, conn_str);
+    }
+    return TCL_OK;
+}
+
+/* ifx::pool create name ?-maxidle n? ?-idletimeout seconds? */
+static int pool_create(Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[]) {
+    static const char *create_options[] = { "-maxidle", "-idletimeout", NULL };
+    int max_idle = IFX_POOL_MAX_IDLE;
+    int idle_timeout = IFX_POOL_IDLE_TIMEOUT;
+    Tcl_HashEntry *entry;
+    IfxPool *pool;
+    int is_new;
+    
+    if (objc < 3 || (objc % 2) != 1) {
+        Tcl_WrongNumArgs(interp, 2, objv, "name ?-maxidle n? ?-idletimeout seconds?");
+        return TCL_ERROR;
+    }
+    for (int i = 3; i < objc; i += 2) {
+        int index, value;
+        
+        if (Tcl_GetIndexFromObj(interp, objv[i], create_options, "option", 0,
+                                &index) != TCL_OK ||
+            Tcl_GetIntFromObj(interp, objv[i+1], &value) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (value < 0) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf("%s must be >= 0", create_options[index]));
+            return TCL_ERROR;
+        }
+        if (index == 0) {
+            max_idle = value;
+        } else {
+            idle_timeout = value;
+        }
+    }
+    
+    Tcl_MutexLock(&pool_mutex);
+    if (!pools_initialized) {
+        Tcl_InitHashTable(&pools, TCL_STRING_KEYS);
+        pools_initialized = 1;
+    }
+    entry = Tcl_CreateHashEntry(&pools, Tcl_GetString(objv[2]), &is_new);
+    if (!is_new) {
+        Tcl_MutexUnlock(&pool_mutex);
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("pool \"%s\" already exists",
+                                               Tcl_GetString(objv[2])));
+        return TCL_ERROR;
+    }
+    pool = (IfxPool *)ckalloc(sizeof(IfxPool));
+    memset(pool, 0, sizeof(IfxPool));
+    pool->max_idle = max_idle;
+    pool->idle_timeout = idle_timeout;
+    Tcl_SetHashValue(entry, pool);
+    Tcl_MutexUnlock(&pool_mutex);
+    
+    Tcl_SetObjResult(interp, objv[2]);
+    return TCL_OK;
+}
+
+/* ifx::pool create|acquire|release|reap|stats|names|destroy ...
+ *
+ *   create name ?-maxidle n? ?-idletimeout seconds?
+ *   acquire name dsn ?user? ?password?   connection handle
+ *   release conn_handle                  same as ifx::disconnect
+ *   reap name                            number of idle connections closed
+ *   stats name                           dict of pool counters
+ *   names                                list of pool names
+ *   destroy name                         closes the idle connections
+ *
+ * A connection from acquire goes back to its pool when it is released or
+ * disconnected. Pools are shared by all interps and threads.
+ */
+static int IfxPool_Cmd(ClientData clientData, Tcl_Interp *interp,
+                       int objc, Tcl_Obj *CONST objv[]) {
+    static const char *subcommands[] = {
+        "acquire", "create", "destroy", "names", "reap", "release", "stats", NULL
+    };
+    enum { POOL_ACQUIRE, POOL_CREATE, POOL_DESTROY, POOL_NAMES, POOL_REAP,
+           POOL_RELEASE, POOL_STATS };
+    IfxPool *pool;
+    IfxIdleDbc *idle;
+    Tcl_WideInt reaped;
+    int index;
+    
+    if (objc < 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "subcommand ?arg ...?");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], subcommands, "subcommand", 0,
+                            &index) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    
+    switch (index) {
+        case POOL_ACQUIRE:
+            return pool_acquire(interp, objc, objv);
+            
+        case POOL_CREATE:
+            return pool_create(interp, objc, objv);
+            
+        case POOL_RELEASE: {
+            IfxConnection *conn;
+            
+            if (objc != 3) {
+                Tcl_WrongNumArgs(interp, 2, objv, "conn_handle");
+                return TCL_ERROR;
+            }
+            conn = (IfxConnection *)close_handle(interp, objv[2], IFX_HANDLE_CONN);
+            if (conn) {
+                release_connection(conn);
+            }
+            return TCL_OK;
+        }
+            
+        case POOL_NAMES: {
+            Tcl_Obj *names = Tcl_NewListObj(0, NULL);
+            Tcl_HashSearch search;
+            
+            if (objc != 2) {
+                Tcl_WrongNumArgs(interp, 2, objv, NULL);
+                return TCL_ERROR;
+            }
+            Tcl_MutexLock(&pool_mutex);
+            if (pools_initialized) {
+                for (Tcl_HashEntry *entry = Tcl_FirstHashEntry(&pools, &search);
+                     entry != NULL; entry = Tcl_NextHashEntry(&search)) {
+                    Tcl_ListObjAppendElement(NULL, names,
+                        Tcl_NewStringObj(Tcl_GetHashKey(&pools, entry), -1));
+                }
+            }
+            Tcl_MutexUnlock(&pool_mutex);
+            Tcl_SetObjResult(interp, names);
+            return TCL_OK;
+        }
+    }
+    
+    /* The rest take just a pool name */
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "name");
+        return TCL_ERROR;
+    }
+    
+    Tcl_MutexLock(&pool_mutex);
+    pool = find_pool(interp, objv[2]);
+    if (!pool) {
+        Tcl_MutexUnlock(&pool_mutex);
+        return TCL_ERROR;
+    }
+    
+    switch (index) {
+        case POOL_REAP:
+            reaped = pool->reaped;
+            idle = take_expired(pool);
+            reaped = pool->reaped - reaped;
+            Tcl_MutexUnlock(&pool_mutex);
+            close_idle(idle);
+            Tcl_SetObjResult(interp, Tcl_NewWideIntObj(reaped));
+            return TCL_OK;
+            
+        case POOL_STATS: {
+            Tcl_Obj *stats = Tcl_NewDictObj();
+            
+            Tcl_DictObjPut(NULL, stats, Tcl_NewStringObj("maxidle", -1),
+                           Tcl_NewIntObj(pool->max_idle));
+            Tcl_DictObjPut(NULL, stats, Tcl_NewStringObj("idletimeout", -1),
+                           Tcl_NewIntObj(pool->idle_timeout));
+            Tcl_DictObjPut(NULL, stats, Tcl_NewStringObj("idle", -1),
+                           Tcl_NewIntObj(pool->idle_count));
+            Tcl_DictObjPut(NULL, stats, Tcl_NewStringObj("active", -1),
+                           Tcl_NewIntObj(pool->active));
+            Tcl_DictObjPut(NULL, stats, Tcl_NewStringObj("hits", -1),
+                           Tcl_NewWideIntObj(pool->hits));
+            Tcl_DictObjPut(NULL, stats, Tcl_NewStringObj("misses", -1),
+                           Tcl_NewWideIntObj(pool->misses));
+            Tcl_DictObjPut(NULL, stats, Tcl_NewStringObj("dead", -1),
+                           Tcl_NewWideIntObj(pool->dead));
+            Tcl_DictObjPut(NULL, stats, Tcl_NewStringObj("reaped", -1),
+                           Tcl_NewWideIntObj(pool->reaped));
+            Tcl_MutexUnlock(&pool_mutex);
+            Tcl_SetObjResult(interp, stats);
+            return TCL_OK;
+        }
+            
+        default:                /* POOL_DESTROY */
+            Tcl_DeleteHashEntry(Tcl_FindHashEntry(&pools, Tcl_GetString(objv[2])));
+            idle = take_idle(pool, time(NULL), NULL);
+            if (pool->active == 0) {
+                ckfree((char *)pool);
+            } else {
+                /* Freed by the release of its last connection */
+                pool->deleted = 1;
+            }
+            Tcl_MutexUnlock(&pool_mutex);
+            close_idle(idle);
+            return TCL_OK;
+    }
+}
+
+/* Message of the first diagnostic record of a handle, for threads that
+ * have no interp to leave it in */
+static void odbc_error_text(SQLSMALLINT handle_type, SQLHANDLE handle, SQLRETURN ret,
+                            char *error_buf, size_t size) {
+    SQLCHAR sqlstate[6] = "00000";
+    SQLCHAR errmsg[1024] = "";
+    SQLINTEGER native_error = 0;
+    SQLSMALLINT errmsg_len = 0;
+    SQLRETURN diag_ret;
+    
+    diag_ret = SQLGetDiagRec(handle_type, handle, 1, 
+                  sqlstate, &native_error, errmsg, sizeof(errmsg), &errmsg_len);
+    
+    if (diag_ret == SQL_SUCCESS || diag_ret == SQL_SUCCESS_WITH_INFO) {
+        snprintf(error_buf, size, 
+                 "SQL error [%s] (%d): %s", sqlstate, (int)native_error, errmsg);
+    } else {
+        snprintf(error_buf, size, 
+                 "SQL execution failed (ret=%d, no diagnostic available)", (int)ret);
+    }
+}
+
+/* Set the interpreter result to the first diagnostic record of a statement */
+static void set_stmt_error(Tcl_Interp *interp, SQLHSTMT hstmt, SQLRETURN ret) {
+    char error_buf[1200];
+    
+    odbc_error_text(SQL_HANDLE_STMT, hstmt, ret, error_buf, sizeof(error_buf));
+    Tcl_SetResult(interp, error_buf, TCL_VOLATILE);
+}
+
+/* Look up a connection handle, leaving an error in interp if invalid */
+static IfxConnection *get_connection(Tcl_Interp *interp, Tcl_Obj *handle) {
+    IfxConnection *conn;
+    
+    conn = (IfxConnection *)lookup_handle(interp, handle, IFX_HANDLE_CONN);
+    if (!conn || !conn->connected) {
+        Tcl_SetResult(interp, "Invalid connection handle", TCL_STATIC);
+        return NULL;
+    }
+    return conn;
+}
+
+/* Look up a prepared statement handle, leaving an error in interp if invalid */
+static IfxStatement *get_statement(Tcl_Interp *interp, Tcl_Obj *handle) {
+    IfxStatement *stmt;
+    
+    stmt = (IfxStatement *)lookup_handle(interp, handle, IFX_HANDLE_STMT);
+    if (!stmt) {
+        Tcl_SetResult(interp, "Invalid statement handle", TCL_STATIC);
+        return NULL;
+    }
+    if (stmt->conn->closed) {
+        Tcl_SetResult(interp, "Connection of the statement was closed", TCL_STATIC);
+        return NULL;
+    }
+    if (stmt->async) {
+        Tcl_SetResult(interp, "Statement is still executing (-async)", TCL_STATIC);
+        return NULL;
+    }
+    return stmt;
+}
+
+/* Look up an open result handle, leaving an error in interp if invalid */
+static IfxResultSet *get_result(Tcl_Interp *interp, Tcl_Obj *handle) {
+    IfxResultSet *result;
+    
+    result = (IfxResultSet *)lookup_handle(interp, handle, IFX_HANDLE_RESULT);
+    if (!result) {
+        Tcl_SetResult(interp, "Invalid result handle", TCL_STATIC);
+        return NULL;
+    }
+    if (result->conn->closed) {
+        Tcl_SetResult(interp, "Connection of the result set was closed", TCL_STATIC);
+        return NULL;
+    }
+    if (result->hstmt == SQL_NULL_HSTMT) {
+        Tcl_SetResult(interp, "Result set was closed by a later execute of its statement",
+                      TCL_STATIC);
+        return NULL;
+    }
+    return result;
+}
+
+/* Is an SQL type one that takes binary data? */
+static int is_binary_type(SQLSMALLINT type) {
+    return type == SQL_BINARY || type == SQL_VARBINARY || type == SQL_LONGVARBINARY;
+}
+
+/* C type to fetch a column as. Without -typed everything is fetched as
+ * text; with it integer and floating point columns are fetched in binary
+ * and become Tcl wide ints and doubles (SERIAL and INT8/SERIAL8 are
+ * reported as INTEGER and BIGINT, SMALLFLOAT as REAL). DECIMAL and MONEY
+ * stay text so no digits are lost to a double. Unless -datetime is text,
+ * DATE and DATETIME are fetched as date/time structs. */
+static SQLSMALLINT column_c_type(const IfxColumn *col, const IfxOptions *opts) {
+    /* BYTE and other binary data as is, not hex encoded */
+    if (is_binary_type(col->sql_type)) {
+        return SQL_C_BINARY;
+    }
+    if (opts->datetime != IFX_DT_TEXT) {
+        switch (col->sql_type) {
+            case SQL_DATE:
+            case SQL_TYPE_DATE:
+                return SQL_C_TYPE_DATE;
+            case SQL_TIME:
+            case SQL_TYPE_TIME:
+                return SQL_C_TYPE_TIME;
+            case SQL_TIMESTAMP:
+            case SQL_TYPE_TIMESTAMP:
+                return SQL_C_TYPE_TIMESTAMP;
+        }
+    }
+    if (!opts->typed) {
+        return SQL_C_CHAR;
+    }
+    switch (col->sql_type) {
+        case SQL_BIT:
+        case SQL_TINYINT:
+        case SQL_SMALLINT:
+        case SQL_INTEGER:
+        case SQL_BIGINT:
+            return SQL_C_SBIGINT;
+        case SQL_REAL:
+        case SQL_FLOAT:
+        case SQL_DOUBLE:
+            return SQL_C_DOUBLE;
+        default:
+            return SQL_C_CHAR;
+    }
+}
+
+/* Bytes needed to hold one value of a column as its C type,
+ * or 0 if the column has to be read with SQLGetData. With expand,
+ * character columns get room for IFX_MAX_CHAR_BYTES per character. */
+static SQLLEN column_width(const IfxColumn *col, int expand) {
+    switch (col->c_type) {
+        case SQL_C_SBIGINT:
+            return sizeof(SQLBIGINT);
+        case SQL_C_DOUBLE:
+            return sizeof(SQLDOUBLE);
+        case SQL_C_TYPE_DATE:
+            return sizeof(SQL_DATE_STRUCT);
+        case SQL_C_TYPE_TIME:
+            return sizeof(SQL_TIME_STRUCT);
+        case SQL_C_TYPE_TIMESTAMP:
+            return sizeof(SQL_TIMESTAMP_STRUCT);
+    }
+    switch (col->sql_type) {
+        case SQL_BIT:
+        case SQL_TINYINT:
+        case SQL_SMALLINT:
+            return 8;
+        case SQL_INTEGER:
+            return 16;
+        case SQL_BIGINT:
+            return 24;
+        case SQL_REAL:
+        case SQL_FLOAT:
+        case SQL_DOUBLE:
+            return 40;
+        case SQL_DECIMAL:
+        case SQL_NUMERIC:
+            /* DECIMAL(p) without scale can reach 10^125 */
+            return 136;
+        case SQL_DATE:
+        case SQL_TIME:
+        case SQL_TIMESTAMP:
+        case SQL_TYPE_DATE:
+        case SQL_TYPE_TIME:
+        case SQL_TYPE_TIMESTAMP:
+            return 40;
+        case SQL_CHAR:
+        case SQL_VARCHAR:
+        case SQL_WCHAR:
+        case SQL_WVARCHAR: {
+            /* The size counts characters; the bytes the driver hands over
+             * can be more (see fetch_overflow) */
+            SQLLEN bytes = col->octets > (SQLLEN)col->size ? col->octets : (SQLLEN)col->size;
+            
+            if (expand && (SQLLEN)col->size * IFX_MAX_CHAR_BYTES > bytes) {
+                bytes = (SQLLEN)col->size * IFX_MAX_CHAR_BYTES;
+            }
+            if (bytes > 0 && bytes < IFX_MAX_BOUND_WIDTH) {
+                return bytes + 1;
+            }
+            return 0;
+        }
+        case SQL_BINARY:
+        case SQL_VARBINARY:
+            /* No terminating NUL for SQL_C_BINARY */
+            if (col->size > 0 && col->size < IFX_MAX_BOUND_WIDTH) {
+                return (SQLLEN)col->size;
+            }
+            return 0;
+        default:
+            /* INTERVAL types */
+            if (col->sql_type >= SQL_INTERVAL_YEAR &&
+                col->sql_type <= SQL_INTERVAL_MINUTE_TO_SECOND) {
+                return 64;
+            }
+            /* TEXT, BYTE, BLOB/CLOB and anything we don't know */
+            return 0;
+    }
+}
+
+static int bind_rowset(IfxResultSet *result, SQLULEN rowset_size);
+static void release_cursor(IfxResultSet *result);
+static void free_result(IfxResultSet *result);
+static void drop_overflow(IfxResultSet *result);
+static int fetch_overflow(Tcl_Interp *interp, IfxResultSet *result);
+static int can_reread(const IfxResultSet *result);
+
+/* Rows of a result that fit in the fetch buffer */
+static SQLLEN rows_per_buffer(const IfxResultSet *result) {
+    SQLLEN fetch_buffer = result->conn->session.fetch_buffer > 0 ?
+                          result->conn->session.fetch_buffer : IFX_DEFAULT_FETCH_BUFFER;
+    SQLLEN rows = result->row_width > 0 ? fetch_buffer / result->row_width : 1;
+    
+    return rows > 0 ? rows : 1;
+}
+
+/* Rows per SQLFetch asked for by -rowsetsize; auto (0) takes one fetch
+ * buffer's worth, so every SQLFetch matches one refill from the server */
+static SQLULEN wanted_rowset(const IfxResultSet *result) {
+    SQLLEN rows;
+    
+    if (result->opts.rowset_size > 0) {
+        return result->opts.rowset_size;
+    }
+    rows = rows_per_buffer(result);
+    return rows < IFX_MAX_AUTO_ROWSET ? rows : IFX_MAX_AUTO_ROWSET;
+}
+
+/* Account for an SQLFetch that read n rows; at_end if it found no more */
+static void count_fetch(IfxResultSet *result, SQLULEN n, int at_end) {
+    SQLLEN per = rows_per_buffer(result);
+    Tcl_WideInt before = result->stats.rows;
+    
+    result->stats.fetches++;
+    result->stats.rows += n;
+    
+    /* One round trip per buffer of rows started, and one more to learn
+     * that a full buffer was the last */
+    result->stats.round_trips += (result->stats.rows + per - 1) / per -
+                                 (before + per - 1) / per;
+    if (at_end && result->stats.rows % per == 0) {
+        result->stats.round_trips++;
+    }
+}
+
+static void add_stats(IfxStats *to, const IfxStats *from) {
+    to->executes += from->executes;
+    to->fetches += from->fetches;
+    to->rows += from->rows;
+    to->round_trips += from->round_trips;
+}
+
+/* Describe the columns of an executed hstmt, bind them and register a
+ * result handle. stmt is the owning prepared statement, or NULL if the
+ * result owns hstmt. On error the cursor is closed, and an hstmt the
+ * result would have owned is freed. */
+static int new_result(Tcl_Interp *interp, SQLHSTMT hstmt, IfxConnection *conn,
+                      IfxStatement *stmt) {
+    IfxResultSet *result;
+    Tcl_Obj *handle;
+    SQLRETURN ret;
+    
+    /* Create result set structure */
+    result = (IfxResultSet *)ckalloc(sizeof(IfxResultSet));
+    memset(result, 0, sizeof(IfxResultSet));
+    result->hstmt = hstmt;
+    result->stmt = stmt;
+    result->conn = conn;
+    result->opts = stmt ? stmt->opts : conn->opts;
+    result->getdata_ext = conn->getdata_ext;
+    result->rowset_size = 1;
+    
+    /* Get number of columns */
+    ret = SQLNumResultCols(hstmt, &result->num_cols);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        result->num_cols = 0;
+    }
+    
+    /* Describe columns */
+    result->cols = (IfxColumn *)ckalloc((result->num_cols + 1) * sizeof(IfxColumn));
+    memset(result->cols, 0, (result->num_cols + 1) * sizeof(IfxColumn));
+    result->row_objv = (Tcl_Obj **)ckalloc((result->num_cols + 1) * sizeof(Tcl_Obj *));
+    for (int i = 0; i < result->num_cols; i++) {
+        IfxColumn *col = &result->cols[i];
+        SQLCHAR col_name[256] = "";
+        SQLSMALLINT name_len;
+        
+        if (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
+            ret = SQLDescribeCol(hstmt, i+1, col_name, sizeof(col_name), &name_len,
+                                 &col->sql_type, &col->size, &col->digits,
+                                 &col->nullable);
+        }
+        
+        col->name = (char *)ckalloc(strlen((char *)col_name) + 1);
+        strcpy(col->name, (char *)col_name);
+        col->name_obj = Tcl_NewStringObj(col->name, -1);
+        Tcl_IncrRefCount(col->name_obj);
+        col->c_type = column_c_type(col, &result->opts);
+        if ((ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) &&
+            (col->sql_type == SQL_CHAR || col->sql_type == SQL_VARCHAR ||
+             col->sql_type == SQL_WCHAR || col->sql_type == SQL_WVARCHAR)) {
+            SQLColAttribute(hstmt, i+1, SQL_DESC_OCTET_LENGTH, NULL, 0, NULL, &col->octets);
+        }
+        col->width = column_width(col, !can_reread(result));
+        result->row_width += col->width > 0 ? col->width : IFX_BLOB_DESCRIPTOR_SIZE;
+    }
+    
+    /* The execute was a round trip; with OPTOFC a query's open waits for
+     * the first fetch */
+    result->stats.executes = 1;
+    if (result->num_cols == 0 || !conn->session.optofc) {
+        result->stats.round_trips = 1;
+    }
+    
+    /* Bind once; every fetch reuses the same buffers */
+    if ((ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) && result->num_cols > 0 &&
+        !bind_rowset(result, wanted_rowset(result))) {
+        ret = SQL_ERROR;
+    }
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        set_stmt_error(interp, hstmt, ret);
+        release_cursor(result);
+        free_result(result);
+        if (!stmt) {
+            SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        }
+        return TCL_ERROR;
+    }
+    
+    if (stmt) {
+        stmt->active = result;
+    } else {
+        conn->users++;
+    }
+    
+    handle = new_handle(interp, IFX_HANDLE_RESULT, result);
+    result->cancel_entry = register_cancel(handle, hstmt);
+    Tcl_SetObjResult(interp, handle);
+    return TCL_OK;
+}
+
+/* Close the cursor of a result and drop the rowset bindings from its hstmt,
+ * which may be reused by the next execute of a prepared statement */
+static void release_cursor(IfxResultSet *result) {
+    if (!result->cursor_closed) {
+        result->cursor_closed = 1;
+        /* With OPTOFC the fetch that reached the end closed the cursor */
+        if (result->num_cols > 0 && !(result->conn->session.optofc && result->done)) {
+            result->stats.round_trips++;
+        }
+        if (result->stmt) {
+            add_stats(&result->stmt->stats, &result->stats);
+        }
+    }
+    SQLFreeStmt(result->hstmt, SQL_CLOSE);
+    if (result->bound) {
+        SQLFreeStmt(result->hstmt, SQL_UNBIND);
+        SQLSetStmtAttr(result->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
+        SQLSetStmtAttr(result->hstmt, SQL_ATTR_ROWS_FETCHED_PTR, NULL, 0);
+        SQLSetStmtAttr(result->hstmt, SQL_ATTR_ROW_STATUS_PTR, NULL, 0);
+        result->bound = 0;
+    }
+}
+
+/* Free a result set structure and its buffers (not the hstmt) */
+static void free_result(IfxResultSet *result) {
+    for (int i = 0; i < result->num_cols; i++) {
+        ckfree(result->cols[i].name);
+        Tcl_DecrRefCount(result->cols[i].name_obj);
+        if (result->cols[i].data) {
+            ckfree(result->cols[i].data);
+            ckfree((char *)result->cols[i].ind);
+        }
+    }
+    drop_overflow(result);
+    ckfree((char *)result->cols);
+    ckfree((char *)result->row_objv);
+    if (result->row_status) {
+        ckfree((char *)result->row_status);
+    }
+    ckfree((char *)result);
+}
+
+/* Bind the columns to column-wise buffers of rowset_size rows, sized from
+ * the described column length. Long columns stay unbound and are read with
+ * SQLGetData; unless the driver allows SQLGetData on any column, only the
+ * bindable columns before the first long one are bound. */
+static int bind_rowset(IfxResultSet *result, SQLULEN rowset_size) {
+    SQLLEN row_width = 0;
+    SQLRETURN ret;
+    int bind_count = 0;
+    int any_column = (result->getdata_ext & SQL_GD_ANY_COLUMN) != 0;
+    
+    for (int i = 0; i < result->num_cols; i++) {
+        if (result->cols[i].next_width > result->cols[i].width) {
+            result->cols[i].width = result->cols[i].next_width;
+        }
+    }
+    for (int i = 0; i < result->num_cols; i++) {
+        if (result->cols[i].width == 0) {
+            if (!any_column) {
+                break;
+            }
+            continue;
+        }
+        row_width += result->cols[i].width;
+        bind_count++;
+    }
+    result->unbound_cols = result->num_cols - bind_count;
+    
+    /* SQLGetData can only read from a single-row rowset */
+    if (rowset_size < 1 || result->unbound_cols > 0) {
+        rowset_size = 1;
+    }
+    if (row_width > 0 && rowset_size * row_width > IFX_MAX_ROWSET_BYTES) {
+        rowset_size = IFX_MAX_ROWSET_BYTES / row_width;
+        if (rowset_size < 1) {
+            rowset_size = 1;
+        }
+    }
+    
+    if (result->bound && !result->widen && rowset_size == result->rowset_size) {
+        return 1;
+    }
+    
+    /* (Re)allocate the buffers; rows still in the old rowset are lost,
+     * so callers only rebind once the current rowset is used up */
+    drop_overflow(result);
+    for (int i = 0, bound = 0; i < result->num_cols; i++) {
+        IfxColumn *col = &result->cols[i];
+        
+        if (col->data) {
+            ckfree(col->data);
+            ckfree((char *)col->ind);
+            col->data = NULL;
+            col->ind = NULL;
+        }
+        if (col->width > 0 && bound < bind_count) {
+            col->data = ckalloc(rowset_size * col->width);
+            col->ind = (SQLLEN *)ckalloc(rowset_size * sizeof(SQLLEN));
+            bound++;
+        }
+    }
+    if (result->row_status) {
+        ckfree((char *)result->row_status);
+    }
+    result->row_status = (SQLUSMALLINT *)ckalloc(rowset_size * sizeof(SQLUSMALLINT));
+    
+    SQLSetStmtAttr(result->hstmt, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER)SQL_BIND_BY_COLUMN, 0);
+    ret = SQLSetStmtAttr(result->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)rowset_size, 0);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        /* Driver refused block fetch, fall back to one row per fetch */
+        rowset_size = 1;
+        SQLSetStmtAttr(result->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
+    }
+    SQLSetStmtAttr(result->hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &result->rows_fetched, 0);
+    SQLSetStmtAttr(result->hstmt, SQL_ATTR_ROW_STATUS_PTR, result->row_status, 0);
+    
+    for (int i = 0; i < result->num_cols; i++) {
+        IfxColumn *col = &result->cols[i];
+        if (col->data) {
+            ret = SQLBindCol(result->hstmt, i+1, col->c_type, col->data, col->width,
+                             col->ind);
+            if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+                break;
+            }
+        }
+    }
+    
+    result->bound = 1;
+    result->widen = 0;
+    result->rowset_size = rowset_size;
+    result->rows_fetched = 0;
+    result->next_row = 0;
+    return ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO;
+}
+
+/* Advance to the next row, fetching a new rowset when the current one is
+ * used up. Returns 1 if a row is available, 0 at end of data, -1 on error. */
+static int next_row(Tcl_Interp *interp, IfxResultSet *result) {
+    SQLRETURN ret;
+    
+    if (result->bound && result->next_row < result->rows_fetched) {
+        result->cur_row = result->next_row++;
+        return 1;
+    }
+    if (result->done) {
+        return 0;
+    }
+    
+    /* Pick up a -rowsetsize changed since the last rowset, and wider
+     * buffers for columns whose values outgrew them */
+    if (result->bound && (result->widen || (wanted_rowset(result) != result->rowset_size &&
+                                            result->unbound_cols == 0)) &&
+        !bind_rowset(result, wanted_rowset(result))) {
+        set_stmt_error(interp, result->hstmt, SQL_ERROR);
+        return -1;
+    }
+    
+    drop_overflow(result);
+    result->rows_fetched = 0;
+    ret = SQLFetch(result->hstmt);
+    
+    if (ret == SQL_NO_DATA) {
+        count_fetch(result, 0, 1);
+        result->done = 1;
+        return 0;
+    }
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        Tcl_SetResult(interp, "Fetch failed", TCL_STATIC);
+        return -1;
+    }
+    
+    if (!result->bound) {
+        count_fetch(result, 1, 0);
+        result->cur_row = 0;
+        return 1;
+    }
+    count_fetch(result, result->rows_fetched, result->rows_fetched == 0);
+    if (result->rows_fetched == 0) {
+        result->done = 1;
+        return 0;
+    }
+    for (SQLULEN r = 0; r < result->rows_fetched; r++) {
+        if (result->row_status[r] == SQL_ROW_ERROR) {
+            Tcl_SetResult(interp, "Fetch failed", TCL_STATIC);
+            return -1;
+        }
+    }
+    /* Truncation comes with SQL_SUCCESS_WITH_INFO (01004) */
+    if (ret == SQL_SUCCESS_WITH_INFO && !fetch_overflow(interp, result)) {
+        return -1;
+    }
+    result->cur_row = 0;
+    result->next_row = 1;
+    return 1;
+}
+
+/* Typed value of a DECIMAL/MONEY column from its text: integral values
+ * that fit become wide ints, anything else keeps the exact decimal string,
+ * which Tcl arithmetic reads as a number when needed */
+static Tcl_Obj *decimal_value(const char *text, int len) {
+    const char *p = text;
+    const char *end = text + len;
+    int digits = 0;
+    
+    const char *start;
+    
+    while (p < end && *p == ' ') p++;
+    while (end > p && end[-1] == ' ') end--;
+    start = p;
+    if (p < end && (*p == '-' || *p == '+')) p++;
+    for (const char *q = p; q < end; q++) {
+        if (*q < '0' || *q > '9') {
+            digits = -1;
+            break;
+        }
+        digits++;
+    }
+    if (digits > 0 && digits <= 18) {
+        char buf[24];
+        
+        len = (int)(end - start);
+        memcpy(buf, start, len);
+        buf[len] = '\0';
+        return Tcl_NewWideIntObj((Tcl_WideInt)strtoll(buf, NULL, 10));
+    }
+    return Tcl_NewStringObj(text, len);
+}
+
+/* Epoch seconds of a date and time taken as local time, which is how
+ * clock scan reads Informix DATETIME values without a zone */
+static Tcl_WideInt local_seconds(int year, int month, int day,
+                                 int hour, int minute, int second) {
+    struct tm tm;
+    
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_sec = second;
+    tm.tm_isdst = -1;
+    return (Tcl_WideInt)mktime(&tm);
+}
+
+/* Epoch value of a date/time in the -datetime unit */
+static Tcl_WideInt epoch_value(int mode, Tcl_WideInt seconds, SQLUINTEGER fraction) {
+    if (mode == IFX_DT_MICROSECONDS) {
+        return seconds * 1000000 + fraction / 1000;
+    }
+    return seconds;
+}
+
+/* Date/time struct of a column fetched as SQL_C_TYPE_DATE/TIME/TIMESTAMP
+ * as ISO-8601 text in iso (returns its length), and as epoch seconds and
+ * fraction. A time of day has no date: its seconds count from midnight. */
+static int datetime_parts(const IfxColumn *col, const char *data, char *iso,
+                          size_t size, Tcl_WideInt *seconds, SQLUINTEGER *fraction) {
+    int n;
+    
+    *fraction = 0;
+    switch (col->c_type) {
+        case SQL_C_TYPE_DATE: {
+            SQL_DATE_STRUCT d;
+            memcpy(&d, data, sizeof(d));
+            *seconds = local_seconds(d.year, d.month, d.day, 0, 0, 0);
+            return snprintf(iso, size, "%04d-%02u-%02u", d.year, d.month, d.day);
+        }
+        case SQL_C_TYPE_TIME: {
+            SQL_TIME_STRUCT t;
+            memcpy(&t, data, sizeof(t));
+            *seconds = t.hour * 3600 + t.minute * 60 + t.second;
+            return snprintf(iso, size, "%02u:%02u:%02u", t.hour, t.minute, t.second);
+        }
+        default: {
+            SQL_TIMESTAMP_STRUCT ts;
+            memcpy(&ts, data, sizeof(ts));
+            *seconds = local_seconds(ts.year, ts.month, ts.day,
+                                     ts.hour, ts.minute, ts.second);
+            *fraction = ts.fraction;
+            n = snprintf(iso, size, "%04d-%02u-%02uT%02u:%02u:%02u",
+                         ts.year, ts.month, ts.day, ts.hour, ts.minute, ts.second);
+            /* Fraction to the precision of the column, FRACTION(n) */
+            if (col->digits > 0) {
+                char frac[16];
+                snprintf(frac, sizeof(frac), "%09u", (unsigned)ts.fraction);
+                n += snprintf(iso + n, size - n, ".%.*s",
+                              col->digits > 9 ? 9 : (int)col->digits, frac);
+            }
+            return n;
+        }
+    }
+}
+
+/* Length of a day-to-second INTERVAL given as text ("[-]D HH:MM:SS.F" or
+ * a suffix of it, as selected by the qualifier) in microseconds. Returns
+ * 0 if the text can't be parsed; year-to-month intervals are not handled. */
+static int interval_micros(SQLSMALLINT sql_type, const char *text, int len,
+                           Tcl_WideInt *micros) {
+    static const Tcl_WideInt unit_secs[] = { 86400, 3600, 60, 1 };
+    const char *p = text;
+    const char *end = text + len;
+    Tcl_WideInt total = 0;
+    int unit, negative = 0;
+    
+    switch (sql_type) {
+        case SQL_INTERVAL_DAY:
+        case SQL_INTERVAL_DAY_TO_HOUR:
+        case SQL_INTERVAL_DAY_TO_MINUTE:
+        case SQL_INTERVAL_DAY_TO_SECOND:
+            unit = 0;
+            break;
+        case SQL_INTERVAL_HOUR:
+        case SQL_INTERVAL_HOUR_TO_MINUTE:
+        case SQL_INTERVAL_HOUR_TO_SECOND:
+            unit = 1;
+            break;
+        case SQL_INTERVAL_MINUTE:
+        case SQL_INTERVAL_MINUTE_TO_SECOND:
+            unit = 2;
+            break;
+        case SQL_INTERVAL_SECOND:
+            unit = 3;
+            break;
+        default:
+            return 0;
+    }
+    
+    while (p < end && *p == ' ') p++;
+    while (end > p && end[-1] == ' ') end--;
+    if (p < end && *p == '-') {
+        negative = 1;
+        p++;
+    }
+    for (;;) {
+        Tcl_WideInt field = 0;
+        
+        if (p >= end || *p < '0' || *p > '9') {
+            return 0;
+        }
+        while (p < end && *p >= '0' && *p <= '9') {
+            field = field * 10 + (*p++ - '0');
+        }
+        total += field * unit_secs[unit] * 1000000;
+        if (p >= end) {
+            break;
+        }
+        if (*p == '.' && unit == 3) {
+            Tcl_WideInt scale = 100000;
+            for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+                total += (*p - '0') * scale;
+                scale /= 10;
+            }
+            break;
+        }
+        if ((*p == ' ' && unit == 0) || (*p == ':' && unit > 0 && unit < 3)) {
+            p++;
+            unit++;
+            continue;
+        }
+        return 0;
+    }
+    *micros = negative ? -total : total;
+    return 1;
+}
+
+/* Convert a fetched value of a column to a Tcl object */
+static Tcl_Obj *make_value(const IfxColumn *col, const char *data, SQLLEN len,
+                           const IfxOptions *opts) {
+    char iso[40];
+    
+    switch (col->c_type) {
+        case SQL_C_BINARY:
+            return Tcl_NewByteArrayObj((const unsigned char *)data, (int)len);
+        case SQL_C_SBIGINT: {
+            SQLBIGINT value;
+            memcpy(&value, data, sizeof(value));
+            return Tcl_NewWideIntObj((Tcl_WideInt)value);
+        }
+        case SQL_C_DOUBLE: {
+            SQLDOUBLE value;
+            memcpy(&value, data, sizeof(value));
+            return Tcl_NewDoubleObj((double)value);
+        }
+        case SQL_C_TYPE_DATE:
+        case SQL_C_TYPE_TIME:
+        case SQL_C_TYPE_TIMESTAMP: {
+            Tcl_WideInt seconds;
+            SQLUINTEGER fraction;
+            int n = datetime_parts(col, data, iso, sizeof(iso), &seconds, &fraction);
+            
+            if (opts->datetime == IFX_DT_ISO) {
+                return Tcl_NewStringObj(iso, n);
+            }
+            return Tcl_NewWideIntObj(epoch_value(opts->datetime, seconds, fraction));
+        }
+    }
+    if (opts->typed && (col->sql_type == SQL_DECIMAL || col->sql_type == SQL_NUMERIC)) {
+        return decimal_value(data, (int)len);
+    }
+    if (opts->datetime >= IFX_DT_SECONDS &&
+        col->sql_type >= SQL_INTERVAL_YEAR &&
+        col->sql_type <= SQL_INTERVAL_MINUTE_TO_SECOND) {
+        Tcl_WideInt micros;
+        if (interval_micros(col->sql_type, data, (int)len, &micros)) {
+            return Tcl_NewWideIntObj(opts->datetime == IFX_DT_SECONDS ?
+                                     micros / 1000000 : micros);
+        }
+    }
+    return Tcl_NewStringObj(data, (int)len);
+}
+
+/* Bytes of data SQLGetData put into a buffer of size bytes */
+static SQLLEN chunk_length(SQLSMALLINT c_type, SQLRETURN ret, SQLLEN indicator,
+                           SQLLEN size) {
+    SQLLEN room = c_type == SQL_C_CHAR ? size - 1 : size;
+    
+    if (ret == SQL_SUCCESS_WITH_INFO || indicator == SQL_NO_TOTAL || indicator > room) {
+        return room;
+    }
+    return indicator;
+}
+
+/* Finish reading a long value of column i whose first chunk (size bytes,
+ * indicator as returned with it) did not hold all of it. The rest is read
+ * straight into the string (or, for binary columns, the byte array) of
+ * the result object, in one call when the driver reports the total
+ * length, else in IFX_GETDATA_CHUNK pieces. */
+static Tcl_Obj *long_value(IfxResultSet *result, int i, const char *first,
+                           SQLLEN size, SQLLEN indicator) {
+    IfxColumn *col = &result->cols[i];
+    int binary = col->c_type == SQL_C_BINARY;
+    int nul = col->c_type == SQL_C_CHAR ? 1 : 0;
+    SQLLEN got = chunk_length(col->c_type, SQL_SUCCESS_WITH_INFO, indicator, size);
+    SQLLEN have = got;
+    Tcl_Obj *obj = binary ? Tcl_NewByteArrayObj((const unsigned char *)first, (int)got)
+                          : Tcl_NewStringObj(first, (int)got);
+    SQLRETURN ret;
+    
+    for (;;) {
+        SQLLEN chunk = IFX_GETDATA_CHUNK;
+        char *dest;
+        
+        /* indicator is what was left before the last call */
+        if (indicator != SQL_NO_TOTAL && indicator > got) {
+            chunk = indicator - got + nul;
+        }
+        if (binary) {
+            dest = (char *)Tcl_SetByteArrayLength(obj, (int)(have + chunk)) + have;
+        } else {
+            Tcl_SetObjLength(obj, (int)(have + chunk));
+            dest = Tcl_GetString(obj) + have;
+        }
+        ret = SQLGetData(result->hstmt, i+1, col->c_type, dest, chunk, &indicator);
+        if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+            break;
+        }
+        got = chunk_length(col->c_type, ret, indicator, chunk);
+        have += got;
+        if (ret == SQL_SUCCESS) {
+            break;
+        }
+    }
+    
+    if (binary) {
+        Tcl_SetByteArrayLength(obj, (int)have);
+    } else {
+        Tcl_SetObjLength(obj, (int)have);
+    }
+    return obj;
+}
+
+/* Forget the values fetch_overflow read for the current rowset */
+static void drop_overflow(IfxResultSet *result) {
+    for (int i = 0; i < result->num_cols; i++) {
+        IfxColumn *col = &result->cols[i];
+        
+        if (!col->full) {
+            continue;
+        }
+        for (SQLULEN r = 0; r < result->rowset_size; r++) {
+            if (col->full[r]) {
+                Tcl_DecrRefCount(col->full[r]);
+            }
+        }
+        ckfree((char *)col->full);
+        col->full = NULL;
+    }
+}
+
+/* Whether the driver lets SQLGetData read a bound column of a block
+ * cursor again (SQL_GD_BOUND and SQL_GD_BLOCK). Without it, character
+ * buffers are sized for the longest multibyte form up front instead. */
+static int can_reread(const IfxResultSet *result) {
+    return (result->getdata_ext & SQL_GD_BOUND) &&
+           (result->getdata_ext & SQL_GD_BLOCK);
+}
+
+/* Read the values of the rowset just fetched that did not fit their
+ * column buffer again, whole, with SQLGetData (positioned on their row
+ * when the rowset has several), and have the next rebind make those
+ * buffers wide enough. Buffers are sized from the described length, but a
+ * client locale with a multibyte code set can make a CHAR(n) longer than
+ * n bytes. A driver that can't read them again (see can_reread) got
+ * buffers with room for that; only the next rowsets are bound wider then.
+ * Returns 0, with the error in interp, if SQLGetData fails. */
+static int fetch_overflow(Tcl_Interp *interp, IfxResultSet *result) {
+    int reread = (result->getdata_ext & SQL_GD_BOUND) &&
+                 (result->rowset_size == 1 || (result->getdata_ext & SQL_GD_BLOCK));
+    
+    for (int i = 0; i < result->num_cols; i++) {
+        IfxColumn *col = &result->cols[i];
+        int binary = col->c_type == SQL_C_BINARY;
+        SQLLEN room;
+        
+        if (!col->data || (!binary && col->c_type != SQL_C_CHAR)) {
+            continue;
+        }
+        room = binary ? col->width : col->width - 1;
+        for (SQLULEN r = 0; r < result->rows_fetched; r++) {
+            SQLLEN len = col->ind[r];
+            char buffer[4096];
+            SQLLEN indicator = SQL_NULL_DATA;
+            SQLRETURN ret;
+            Tcl_Obj *value;
+            int n;
+            
+            if (len == SQL_NULL_DATA || (len != SQL_NO_TOTAL && len <= room)) {
+                continue;
+            }
+            if (!reread) {
+                n = len == SQL_NO_TOTAL ? 2 * (int)col->width : (int)len + !binary;
+                if (n > col->next_width && col->width < IFX_MAX_BOUND_WIDTH) {
+                    col->next_width = n < IFX_MAX_BOUND_WIDTH ? n : IFX_MAX_BOUND_WIDTH;
+                    result->widen = 1;
+                }
+                continue;
+            }
+            if (result->rowset_size > 1) {
+                ret = SQLSetPos(result->hstmt, r + 1, SQL_POSITION, SQL_LOCK_NO_CHANGE);
+                if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+                    set_stmt_error(interp, result->hstmt, ret);
+                    return 0;
+                }
+            }
+            ret = SQLGetData(result->hstmt, i+1, col->c_type, buffer, sizeof(buffer),
+                             &indicator);
+            if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+                set_stmt_error(interp, result->hstmt, ret);
+                return 0;
+            }
+            if (indicator == SQL_NULL_DATA) {
+                continue;
+            }
+            if (ret == SQL_SUCCESS_WITH_INFO) {
+                value = long_value(result, i, buffer, sizeof(buffer), indicator);
+            } else if (binary) {
+                value = Tcl_NewByteArrayObj((unsigned char *)buffer, (int)indicator);
+            } else {
+                value = Tcl_NewStringObj(buffer, (int)indicator);
+            }
+            Tcl_IncrRefCount(value);
+            if (!col->full) {
+                col->full = (Tcl_Obj **)ckalloc(result->rowset_size * sizeof(Tcl_Obj *));
+                memset(col->full, 0, result->rowset_size * sizeof(Tcl_Obj *));
+            }
+            col->full[r] = value;
+            
+            if (binary) {
+                Tcl_GetByteArrayFromObj(value, &n);
+            } else {
+                Tcl_GetStringFromObj(value, &n);
+                n++;
+            }
+            if (n > col->next_width && col->width < IFX_MAX_BOUND_WIDTH) {
+                col->next_width = n < IFX_MAX_BOUND_WIDTH ? n : IFX_MAX_BOUND_WIDTH;
+                result->widen = 1;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Length of the value of a bound column in row of the current rowset,
+ * cut to what its buffer holds, or SQL_NULL_DATA */
+static SQLLEN bound_length(const IfxColumn *col, SQLULEN row) {
+    SQLLEN len = col->ind[row];
+    
+    if (len == SQL_NULL_DATA) {
+        return len;
+    }
+    if (col->c_type == SQL_C_CHAR &&
+        (len == SQL_NO_TOTAL || len > col->width - 1)) {
+        len = col->width - 1;
+    } else if (col->c_type == SQL_C_BINARY && (len == SQL_NO_TOTAL || len > col->width)) {
+        len = col->width;
+    }
+    return len;
+}
+
+/* Bytes of the value of a bound column in row of the current rowset, and
+ * their length in *len (SQL_NULL_DATA for NULL). A value that outgrew the
+ * buffer comes from the copy fetch_overflow read. */
+static const char *bound_data(const IfxColumn *col, SQLULEN row, SQLLEN *len) {
+    if (col->full && col->full[row]) {
+        int n;
+        const char *bytes;
+        
+        if (col->c_type == SQL_C_BINARY) {
+            bytes = (const char *)Tcl_GetByteArrayFromObj(col->full[row], &n);
+        } else {
+            bytes = Tcl_GetStringFromObj(col->full[row], &n);
+        }
+        *len = n;
+        return bytes;
+    }
+    *len = bound_length(col, row);
+    return col->data + row * col->width;
+}
+
+/* Value of bound column i in row of the current rowset */
+static Tcl_Obj *bound_value(IfxResultSet *result, int i, SQLULEN row) {
+    IfxColumn *col = &result->cols[i];
+    SQLLEN len;
+    const char *data = bound_data(col, row, &len);
+    
+    if (len == SQL_NULL_DATA) {
+        return Tcl_NewObj();
+    }
+    return make_value(col, data, len, &result->opts);
+}
+
+/* Value of column i in the current row as a new Tcl object */
+static Tcl_Obj *column_value(IfxResultSet *result, int i) {
+    IfxColumn *col = &result->cols[i];
+    
+    if (col->data) {
+        return bound_value(result, i, result->cur_row);
+    } else {
+        SQLCHAR buffer[4096];
+        SQLLEN indicator = SQL_NULL_DATA;
+        SQLRETURN ret;
+        
+        ret = SQLGetData(result->hstmt, i+1, col->c_type, buffer, 
+                        sizeof(buffer), &indicator);
+        
+        if ((ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) ||
+            indicator == SQL_NULL_DATA) {
+            return Tcl_NewObj();
+        }
+        if (ret == SQL_SUCCESS_WITH_INFO) {
+            /* Doesn't fit: read the rest in chunks */
+            return long_value(result, i, (char *)buffer, sizeof(buffer), indicator);
+        }
+        return make_value(col, (char *)buffer, indicator, &result->opts);
+    }
+}
+
+/* Build the current row as a dict of column name -> value. The keys are
+ * the column name objects of the result, shared by all its rows. */
+static Tcl_Obj *row_as_dict(Tcl_Interp *interp, IfxResultSet *result) {
+    Tcl_Obj *row_dict = Tcl_NewDictObj();
+    
+    for (int i = 0; i < result->num_cols; i++) {
+        Tcl_DictObjPut(interp, row_dict, result->cols[i].name_obj,
+                       column_value(result, i));
+    }
+    return row_dict;
+}
+
+/* Build the current row as a list of values in column order, created
+ * at its final size instead of grown element by element */
+static Tcl_Obj *row_as_list(IfxResultSet *result) {
+    for (int i = 0; i < result->num_cols; i++) {
+        result->row_objv[i] = column_value(result, i);
+    }
+    return Tcl_NewListObj(result->num_cols, result->row_objv);
+}
+
+/* Apply -timeout and -maxrows to hstmt. A new hstmt has no limits, so
+ * unless force is set nothing is done for options left at 0. */
+static void set_stmt_limits(SQLHSTMT hstmt, const IfxOptions *opts, int force) {
+    if (force || opts->timeout > 0) {
+        /* ODBC counts whole seconds; round up so a timeout never becomes 0 */
+        SQLULEN seconds = ((SQLULEN)opts->timeout + 999) / 1000;
+        SQLSetStmtAttr(hstmt, SQL_ATTR_QUERY_TIMEOUT, (SQLPOINTER)seconds, 0);
+    }
+    if (force || opts->max_rows > 0) {
+        SQLSetStmtAttr(hstmt, SQL_ATTR_MAX_ROWS, (SQLPOINTER)(SQLULEN)opts->max_rows, 0);
+    }
+}
+
+/* ifx::execute conn_handle sql ?param1 param2 ...? */
+static int IfxExecute_Cmd(ClientData clientData, Tcl_Interp *interp,
+                          int objc, Tcl_Obj *CONST objv[]) {
+    IfxConnection *conn;
+    SQLHSTMT hstmt;
+    SQLRETURN ret;
+    Tcl_HashEntry *cancel_entry;
+    char *sql;
+    
+    if (objc < 3) {
+        Tcl_WrongNumArgs(interp, 1, objv, "conn_handle sql ?params?");
+        return TCL_ERROR;
+    }
+    
+    sql = Tcl_GetString(objv[2]);
+    
+    /* Get connection */
+    conn = get_connection(interp, objv[1]);
+    if (!conn) {
+        return TCL_ERROR;
+    }
+    
+    /* Allocate statement handle */
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, conn->hdbc, &hstmt);
+    if (ret != SQL_SUCCESS) {
+        Tcl_SetResult(interp, "Failed to allocate statement handle", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    
+    set_stmt_limits(hstmt, &conn->opts, 0);
+    
+    /* Execute SQL; there is no result handle yet, so while it runs
+     * ifx::cancel reaches it by the connection handle */
+    cancel_entry = register_cancel(objv[1], hstmt);
+    ret = SQLExecDirect(hstmt, (SQLCHAR *)sql, SQL_NTS);
+    unregister_cancel(&cancel_entry);
+    /* SQL_NO_DATA (100) is returned for DELETE/UPDATE that affect 0 rows - not an error */
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO && ret != SQL_NO_DATA) {
+        /* Get detailed error message from the database */
+        set_stmt_error(interp, hstmt, ret);
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return TCL_ERROR;
+    }
+    
+    return new_result(interp, hstmt, conn, NULL);
+}
+
+/* Prepare sql on a new hstmt of conn and describe its parameters.
+ * Returns NULL, with the error in interp, if it can't be prepared. */
+static IfxStatement *prepare_statement(Tcl_Interp *interp, IfxConnection *conn,
+                                       const char *sql) {
+    IfxStatement *stmt;
+    SQLHSTMT hstmt;
+    SQLRETURN ret;
+    SQLSMALLINT num_params = 0;
+    
+    ret = SQLAllocHandle(SQL_HANDLE_STMT, conn->hdbc, &hstmt);
+    if (ret != SQL_SUCCESS) {
+        Tcl_SetResult(interp, "Failed to allocate statement handle", TCL_STATIC);
+        return NULL;
+    }
+    
+    set_stmt_limits(hstmt, &conn->opts, 0);
+    
+    ret = SQLPrepare(hstmt, (SQLCHAR *)sql, SQL_NTS);
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        set_stmt_error(interp, hstmt, ret);
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return NULL;
+    }
+    
+    SQLNumParams(hstmt, &num_params);
+    
+    stmt = (IfxStatement *)ckalloc(sizeof(IfxStatement));
+    stmt->hstmt = hstmt;
+    stmt->conn = conn;
+    stmt->num_params = num_params;
+    stmt->active = NULL;
+    stmt->opts = conn->opts;
+    stmt->async = NULL;
+    stmt->cancel_entry = NULL;
+    stmt->limits_changed = 0;
+    memset(&stmt->stats, 0, sizeof(stmt->stats));
+    stmt->stats.round_trips = 1;
+    stmt->param_types = (SQLSMALLINT *)ckalloc((num_params + 1) * sizeof(SQLSMALLINT));
+    stmt->param_sizes = (SQLULEN *)ckalloc((num_params + 1) * sizeof(SQLULEN));
+    stmt->param_digits = (SQLSMALLINT *)ckalloc((num_params + 1) * sizeof(SQLSMALLINT));
+    stmt->param_ind = (SQLLEN *)ckalloc((num_params + 1) * sizeof(SQLLEN));
+    
+    /* Describe parameters; fall back to VARCHAR if the driver can't */
+    for (int i = 0; i < num_params; i++) {
+        SQLSMALLINT nullable;
+        
+        ret = SQLDescribeParam(hstmt, i+1, &stmt->param_types[i],
+                               &stmt->param_sizes[i], &stmt->param_digits[i],
+                               &nullable);
+        if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+            stmt->param_types[i] = SQL_VARCHAR;
+            stmt->param_sizes[i] = 0;
+            stmt->param_digits[i] = 0;
+        }
+    }
+    
+    conn->users++;
+    return stmt;
+}
+
+/* ifx::prepare conn_handle sql
+ *
+ * Prepares sql once on the server (SQLPrepare) and returns a statement
+ * handle. Parameters are written as ? markers; their types are described
+ * here so that every execute can bind without another round trip.
+ */
+static int IfxPrepare_Cmd(ClientData clientData, Tcl_Interp *interp,
+                          int objc, Tcl_Obj *CONST objv[]) {
+    IfxConnection *conn;
+    IfxStatement *stmt;
+    Tcl_Obj *handle;
+    
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 1, objv, "conn_handle sql");
+        return TCL_ERROR;
+    }
+    
+    conn = get_connection(interp, objv[1]);
+    if (!conn) {
+        return TCL_ERROR;
+    }
+    
+    stmt = prepare_statement(interp, conn, Tcl_GetString(objv[2]));
+    if (!stmt) {
+        return TCL_ERROR;
+    }
+    
+    handle = new_handle(interp, IFX_HANDLE_STMT, stmt);
+    stmt->cancel_entry = register_cancel(handle, stmt->hstmt);
+    Tcl_SetObjResult(interp, handle);
+    return TCL_OK;
+}
+
+/* Is an SQL type one that takes character data? */
+static int is_char_type(SQLSMALLINT type) {
+    switch (type) {
+        case SQL_CHAR:
+        case SQL_VARCHAR:
+        case SQL_LONGVARCHAR:
+        case SQL_WCHAR:
+        case SQL_WVARCHAR:
+        case SQL_WLONGVARCHAR:
+            return 1;
+    }
+    return 0;
+}
+
+/* Detach a result set from its statement: its cursor is gone */
+static void detach_result(IfxStatement *stmt) {
+    if (stmt->active) {
+        unregister_cancel(&stmt->active->cancel_entry);
+        release_cursor(stmt->active);
+        stmt->active->hstmt = SQL_NULL_HSTMT;
+        stmt->active->stmt = NULL;
+        stmt->active = NULL;
+    }
+}
+
+/* Get a statement ready for the next execute: close the cursor of the
+ * previous one and apply limits configured since */
+static void reset_statement(IfxStatement *stmt) {
+    detach_result(stmt);
+    if (stmt->limits_changed) {
+        set_stmt_limits(stmt->hstmt, &stmt->opts, 1);
+        stmt->limits_changed = 0;
+    }
+}
+
+/* Free a statement, its hstmt and the cursor of its open result */
+static void free_statement(IfxStatement *stmt) {
+    detach_result(stmt);
+    unregister_cancel(&stmt->cancel_entry);
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt->hstmt);
+    drop_connection_user(stmt->conn);
+    
+    ckfree((char *)stmt->param_types);
+    ckfree((char *)stmt->param_sizes);
+    ckfree((char *)stmt->param_digits);
+    ckfree((char *)stmt->param_ind);
+    ckfree((char *)stmt);
+}
+
+/* Is an SQL type a long (TEXT/BYTE style) type? */
+static int is_long_type(SQLSMALLINT type) {
+    return type == SQL_LONGVARCHAR || type == SQL_WLONGVARCHAR ||
+           type == SQL_LONGVARBINARY;
+}
+
+/* Byte array values, as fetched from binary columns */
+static const Tcl_ObjType *bytearray_type;
+
+/* Bytes to send for a parameter value. A byte array for a binary (BYTE
+ * etc.) parameter is sent as its raw bytes, bound as SQL_C_BINARY;
+ * anything else as its string rep. */
+static char *param_bytes(Tcl_Obj *value, SQLSMALLINT sql_type, int *len, int *binary) {
+    *binary = value->typePtr == bytearray_type && bytearray_type != NULL &&
+              is_binary_type(sql_type);
+    if (*binary) {
+        return (char *)Tcl_GetByteArrayFromObj(value, len);
+    }
+    return Tcl_GetStringFromObj(value, len);
+}
+
+/* Send the value of a data-at-execution parameter with SQLPutData, in
+ * IFX_PUTDATA_CHUNK pieces from bytes or, if chan is given, from the
+ * channel until end of file */
+static int put_param_data(Tcl_Interp *interp, SQLHSTMT hstmt, char *bytes,
+                          int len, Tcl_Channel chan) {
+    SQLRETURN ret = SQL_SUCCESS;
+    int sent = 0;
+    
+    if (chan == NULL) {
+        do {
+            int n = len - sent > IFX_PUTDATA_CHUNK ? IFX_PUTDATA_CHUNK : len - sent;
+            ret = SQLPutData(hstmt, bytes + sent, n);
+            sent += n;
+        } while (sent < len && (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO));
+    } else {
+        char *buffer = ckalloc(IFX_PUTDATA_CHUNK);
+        
+        for (;;) {
+            int n = Tcl_Read(chan, buffer, IFX_PUTDATA_CHUNK);
+            if (n < 0) {
+                ckfree(buffer);
+                Tcl_SetObjResult(interp, Tcl_ObjPrintf("error reading channel: %s",
+                                                       Tcl_PosixError(interp)));
+                return TCL_ERROR;
+            }
+            if (n == 0 && sent > 0) {
+                break;
+            }
+            ret = SQLPutData(hstmt, buffer, n);
+            if ((ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) || n == 0) {
+                break;
+            }
+            sent += n;
+        }
+        ckfree(buffer);
+    }
+    
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+        set_stmt_error(interp, hstmt, ret);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/* Bind parameter i of a statement to value (len bytes, NUL terminated),
+ * which must stay valid until the execute is done. Long values, values for
+ * long types and channel-fed parameters (from_chan) are bound for data at
+ * execution, with the parameter number as the token SQLParamData hands
+ * back. */
+static SQLRETURN bind_param(IfxStatement *stmt, int i, char *value, int len,
+                            int from_chan, int binary) {
+    SQLULEN col_size = stmt->param_sizes[i];
+    SQLSMALLINT sql_type = stmt->param_types[i];
+    SQLSMALLINT c_type = binary || (from_chan && is_binary_type(sql_type)) ?
+                         SQL_C_BINARY : SQL_C_CHAR;
+    
+    if (from_chan || len > IFX_PUTDATA_THRESHOLD || (len > 0 && is_long_type(sql_type))) {
+        stmt->param_ind[i] = from_chan ? SQL_DATA_AT_EXEC : SQL_LEN_DATA_AT_EXEC(len);
+        if (from_chan && col_size == 0) {
+            col_size = 0x7fffffff;
+        } else if (col_size < (SQLULEN)len) {
+            col_size = len;
+        }
+        return SQLBindParameter(stmt->hstmt, i+1, SQL_PARAM_INPUT, c_type,
+                                sql_type, col_size, stmt->param_digits[i],
+                                (SQLPOINTER)(SQLLEN)(i + 1), 0, &stmt->param_ind[i]);
+    }
+    
+    /* An empty value for a non-character parameter is sent as NULL,
+     * which is what Informix makes of a '' literal */
+    if (len == 0 && !is_char_type(sql_type)) {
+        stmt->param_ind[i] = SQL_NULL_DATA;
+    } else {
+        stmt->param_ind[i] = len;
+    }
+    if (col_size < (SQLULEN)len) {
+        col_size = len;
+    }
+    if (col_size == 0) {
+        col_size = 1;
+    }
+    
+    return SQLBindParameter(stmt->hstmt, i+1, SQL_PARAM_INPUT, c_type,
+                            sql_type, col_size, stmt->param_digits[i],
+                            value, len + 1, &stmt->param_ind[i]);
+}
+
+/* An execute -async in progress. The parameter values are copied so that
+ * the helper thread doesn't touch Tcl objects; it only runs SQLExecute
+ * (and SQLPutData for data-at-exec values) and queues an IfxAsyncEvent
+ * back to the thread that started it. */
+typedef struct IfxAsyncExec {
+    IfxStatement *stmt;
+    Tcl_Interp *interp;
+    Tcl_Obj *callback;
+    Tcl_ThreadId origin;
+    int num_values;
+    char **values;              /* copies, NUL terminated */
+    int *lens;
+    int *binary;                /* value is raw bytes for a binary parameter */
+    SQLRETURN ret;              /* of SQLExecute, set by the helper thread */
+    int closed;                 /* statement closed while executing */
+} IfxAsyncExec;
+
+typedef struct {
+    Tcl_Event header;
+    IfxAsyncExec *exec;
+} IfxAsyncEvent;
+
+static int async_execute_done(Tcl_Event *evPtr, int flags);
+
+static void free_async_exec(IfxAsyncExec *exec) {
+    for (int i = 0; i < exec->num_values; i++) {
+        ckfree(exec->values[i]);
+    }
+    ckfree((char *)exec->values);
+    ckfree((char *)exec->lens);
+    ckfree((char *)exec->binary);
+    Tcl_DecrRefCount(exec->callback);
+    ckfree((char *)exec);
+}
+
+/* Body of the helper thread of an execute -async */
+static Tcl_ThreadCreateType async_execute(ClientData clientData) {
+    IfxAsyncExec *exec = (IfxAsyncExec *)clientData;
+    SQLHSTMT hstmt = exec->stmt->hstmt;
+    IfxAsyncEvent *event;
+    SQLRETURN ret;
+    
+    ret = SQLExecute(hstmt);
+    while (ret == SQL_NEED_DATA) {
+        SQLPOINTER token;
+        SQLRETURN put_ret;
+        int index, offset = 0;
+        
+        ret = SQLParamData(hstmt, &token);
+        if (ret != SQL_NEED_DATA) {
+            break;
+        }
+        index = (int)(SQLLEN)token - 1;
+        do {
+            int n = exec->lens[index] - offset;
+            if (n > IFX_PUTDATA_CHUNK) {
+                n = IFX_PUTDATA_CHUNK;
+            }
+            put_ret = SQLPutData(hstmt, exec->values[index] + offset, n);
+            offset += n;
+        } while ((put_ret == SQL_SUCCESS || put_ret == SQL_SUCCESS_WITH_INFO) &&
+                 offset < exec->lens[index]);
+        if (put_ret != SQL_SUCCESS && put_ret != SQL_SUCCESS_WITH_INFO) {
+            SQLCancel(hstmt);
+            ret = put_ret;
+            break;
+        }
+    }
+    exec->ret = ret;
+    
+    event = (IfxAsyncEvent *)ckalloc(sizeof(IfxAsyncEvent));
+    event->header.proc = async_execute_done;
+    event->exec = exec;
+    Tcl_ThreadQueueEvent(exec->origin, &event->header, TCL_QUEUE_TAIL);
+    Tcl_ThreadAlert(exec->origin);
+    
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/* Event handler in the thread that started an execute -async: create the
+ * result set and run the callback with "ok result_handle" or "error msg" */
+static int async_execute_done(Tcl_Event *evPtr, int flags) {
+    IfxAsyncExec *exec = ((IfxAsyncEvent *)evPtr)->exec;
+    IfxStatement *stmt = exec->stmt;
+    Tcl_Interp *interp = exec->interp;
+    SQLRETURN ret = exec->ret;
+    Tcl_Obj *cmd;
+    int code;
+    
+    if (!(flags & TCL_FILE_EVENTS)) {
+        return 0;
+    }
+    
+    stmt->async = NULL;
+    if (exec->closed || Tcl_InterpDeleted(interp)) {
+        if (exec->closed) {
+            free_statement(stmt);
+        } else {
+            SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+        }
+        Tcl_Release(interp);
+        free_async_exec(exec);
+        return 1;
+    }
+    
+    cmd = Tcl_DuplicateObj(exec->callback);
+    Tcl_IncrRefCount(cmd);
+    if (stmt->conn->closed) {
+        /* Disconnected while executing; the hdbc goes once the statement
+         * is closed */
+        Tcl_SetResult(interp, "Connection of the statement was closed", TCL_STATIC);
+        SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+        code = TCL_ERROR;
+    } else if (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO || ret == SQL_NO_DATA) {
+        code = new_result(interp, stmt->hstmt, stmt->conn, stmt);
+    } else {
+        set_stmt_error(interp, stmt->hstmt, ret);
+        SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+        code = TCL_ERROR;
+    }
+    Tcl_ListObjAppendElement(NULL, cmd, Tcl_NewStringObj(code == TCL_OK ? "ok" : "error", -1));
+    Tcl_ListObjAppendElement(NULL, cmd, Tcl_GetObjResult(interp));
+    Tcl_ResetResult(interp);
+    
+    code = Tcl_EvalObjEx(interp, cmd, TCL_EVAL_GLOBAL);
+    if (code != TCL_OK) {
+        Tcl_BackgroundException(interp, code);
+    }
+    Tcl_DecrRefCount(cmd);
+    
+    Tcl_Release(interp);
+    free_async_exec(exec);
+    return 1;
+}
+
+/* Bind copies of values and start executing stmt in a helper thread */
+static int execute_async(Tcl_Interp *interp, IfxStatement *stmt, Tcl_Obj **values,
+                         int num_values, Tcl_Obj *callback) {
+    IfxAsyncExec *exec = (IfxAsyncExec *)ckalloc(sizeof(IfxAsyncExec));
+    Tcl_ThreadId thread;
+    SQLRETURN ret;
+    
+    exec->stmt = stmt;
+    exec->interp = interp;
+    exec->callback = callback;
+    Tcl_IncrRefCount(callback);
+    exec->origin = Tcl_GetCurrentThread();
+    exec->closed = 0;
+    exec->num_values = num_values;
+    exec->values = (char **)ckalloc((num_values + 1) * sizeof(char *));
+    exec->lens = (int *)ckalloc((num_values + 1) * sizeof(int));
+    exec->binary = (int *)ckalloc((num_values + 1) * sizeof(int));
+    for (int i = 0; i < num_values; i++) {
+        const char *value = param_bytes(values[i], stmt->param_types[i], &exec->lens[i],
+                                        &exec->binary[i]);
+        exec->values[i] = ckalloc(exec->lens[i] + 1);
+        memcpy(exec->values[i], value, exec->lens[i]);
+        exec->values[i][exec->lens[i]] = '\0';
+    }
+    
+    /* Close the cursor of the previous execute, if any */
+    reset_statement(stmt);
+    
+    for (int i = 0; i < num_values; i++) {
+        ret = bind_param(stmt, i, exec->values[i], exec->lens[i], 0, exec->binary[i]);
+        if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+            set_stmt_error(interp, stmt->hstmt, ret);
+            free_async_exec(exec);
+            return TCL_ERROR;
+        }
+    }
+    
+    stmt->async = exec;
+    Tcl_Preserve(interp);
+    if (Tcl_CreateThread(&thread, async_execute, exec, TCL_THREAD_STACK_DEFAULT,
+                         TCL_THREAD_NOFLAGS) != TCL_OK) {
+        stmt->async = NULL;
+        Tcl_Release(interp);
+        free_async_exec(exec);
+        Tcl_SetResult(interp, "Failed to start a thread for -async", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/* ifx::execute_prepared stmt_handle ?-async callback? ?-channels {index channel ...}?
+ *                      ?param_list?
+ *
+ * Binds the values of param_list to the ? markers and executes the
+ * prepared statement. Returns a result handle like ifx::execute.
+ *
+ * With -async the statement is executed in a helper thread and the command
+ * returns at once; when it completes, callback is run from the event loop
+ * at global level with "ok result_handle" or "error message" appended. The
+ * statement can't be used until then, except to close it. -async can't be
+ * combined with -channels.
+ *
+ * Values longer than IFX_PUTDATA_THRESHOLD and values for TEXT/BYTE
+ * parameters are sent at execution time with SQLPutData in chunks rather
+ * than bound as one buffer. -channels names parameters (by 0-based index)
+ * whose value is read from a channel instead, up to end of file; their
+ * entries in param_list are ignored. Channels for BYTE parameters should
+ * be configured -translation binary.
+ */
+static int IfxExecutePrepared_Cmd(ClientData clientData, Tcl_Interp *interp,
+                                  int objc, Tcl_Obj *CONST objv[]) {
+    IfxStatement *stmt;
+    SQLRETURN ret;
+    Tcl_Obj **values = NULL;
+    Tcl_Obj **chan_objv = NULL;
+    Tcl_Channel *chans = NULL;
+    Tcl_Obj *empty_list = NULL;
+    int num_values = 0;
+    int num_chans = 0;
+    int arg = 2;
+    int status = TCL_ERROR;
+    Tcl_Obj *callback = NULL;
+    
+    while (arg + 1 < objc) {
+        const char *opt = Tcl_GetString(objv[arg]);
+        
+        if (strcmp(opt, "-channels") == 0) {
+            if (Tcl_ListObjGetElements(interp, objv[arg+1], &num_chans,
+                                       &chan_objv) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            if (num_chans % 2 != 0) {
+                Tcl_SetResult(interp, "-channels must be a list of index channel pairs",
+                              TCL_STATIC);
+                return TCL_ERROR;
+            }
+        } else if (strcmp(opt, "-async") == 0) {
+            callback = objv[arg+1];
+        } else {
+            break;
+        }
+        arg += 2;
+    }
+    if (objc < 2 || objc > arg + 1) {
+        Tcl_WrongNumArgs(interp, 1, objv,
+                         "stmt_handle ?-async callback? ?-channels {index channel ...}? ?param_list?");
+        return TCL_ERROR;
+    }
+    if (callback && num_chans > 0) {
+        Tcl_SetResult(interp, "-async can't be combined with -channels", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    
+    stmt = get_statement(interp, objv[1]);
+    if (!stmt) {
+        return TCL_ERROR;
+    }
+    
+    if (objc == arg + 1 &&
+        Tcl_ListObjGetElements(interp, objv[arg], &num_values, &values) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    
+    /* Channel-fed parameters don't need a value in the list */
+    if (num_values == 0 && num_chans > 0) {
+        empty_list = Tcl_NewListObj(0, NULL);
+        Tcl_IncrRefCount(empty_list);
+        num_values = stmt->num_params;
+        values = (Tcl_Obj **)ckalloc((num_values + 1) * sizeof(Tcl_Obj *));
+        for (int i = 0; i < num_values; i++) {
+            values[i] = empty_list;
+        }
+    }
+    
+    if (num_values != stmt->num_params) {
+        char error_buf[128];
+        snprintf(error_buf, sizeof(error_buf),
+                 "wrong number of parameters: expected %d, got %d",
+                 (int)stmt->num_params, num_values);
+        Tcl_SetResult(interp, error_buf, TCL_VOLATILE);
+        goto done;
+    }
+    
+    if (callback) {
+        return execute_async(interp, stmt, values, num_values, callback);
+    }
+    
+    chans = (Tcl_Channel *)ckalloc((num_values + 1) * sizeof(Tcl_Channel));
+    memset(chans, 0, (num_values + 1) * sizeof(Tcl_Channel));
+    for (int i = 0; i < num_chans; i += 2) {
+        int index, mode;
+        
+        if (Tcl_GetIntFromObj(interp, chan_objv[i], &index) != TCL_OK) {
+            goto done;
+        }
+        if (index < 0 || index >= num_values) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf("parameter index %d out of range", index));
+            goto done;
+        }
+        chans[index] = Tcl_GetChannel(interp, Tcl_GetString(chan_objv[i+1]), &mode);
+        if (chans[index] == NULL) {
+            goto done;
+        }
+        if (!(mode & TCL_READABLE)) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf("channel \"%s\" wasn't opened for reading",
+                                                   Tcl_GetString(chan_objv[i+1])));
+            goto done;
+        }
+    }
+    
+    /* Close the cursor of the previous execute, if any */
+    reset_statement(stmt);
+    
+    /* Bind parameters straight from the Tcl string reps (or byte arrays);
+     * they stay valid for the duration of this command */
+    for (int i = 0; i < num_values; i++) {
+        int len, binary;
+        char *value = param_bytes(values[i], stmt->param_types[i], &len, &binary);
+        
+        ret = bind_param(stmt, i, value, len, chans[i] != NULL, binary);
+        if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+            set_stmt_error(interp, stmt->hstmt, ret);
+            goto done;
+        }
+    }
+    
+    ret = SQLExecute(stmt->hstmt);
+    
+    /* Feed the data-at-execution parameters in the order asked for */
+    while (ret == SQL_NEED_DATA) {
+        SQLPOINTER token;
+        char *bytes = NULL;
+        int index, len = 0, binary;
+        
+        ret = SQLParamData(stmt->hstmt, &token);
+        if (ret != SQL_NEED_DATA) {
+            break;
+        }
+        index = (int)(SQLLEN)token - 1;
+        if (chans[index] == NULL) {
+            bytes = param_bytes(values[index], stmt->param_types[index], &len, &binary);
+        }
+        if (put_param_data(interp, stmt->hstmt, bytes, len, chans[index]) != TCL_OK) {
+            SQLCancel(stmt->hstmt);
+            goto done;
+        }
+    }
+    
+    /* SQL_NO_DATA is returned for DELETE/UPDATE that affect 0 rows */
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO && ret != SQL_NO_DATA) {
+        set_stmt_error(interp, stmt->hstmt, ret);
+        SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+        goto done;
+    }
+    
+    status = new_result(interp, stmt->hstmt, stmt->conn, stmt);
+    
+done:
+    if (chans) {
+        ckfree((char *)chans);
+    }
+    if (empty_list) {
+        ckfree((char *)values);
+        Tcl_DecrRefCount(empty_list);
+    }
+    return status;
+}
+
+/* Rows per SQLExecute in ifx::execute_many unless -batch says otherwise */
+#define IFX_DEFAULT_BATCH_SIZE 1000
+
+/* Number of rows from first on (at most limit) whose parameter arrays fit
+ * in IFX_MAX_ROWSET_BYTES, at least one */
+static int batch_rows(IfxStatement *stmt, Tcl_Obj **rows, int first, int limit) {
+    SQLLEN *widths = (SQLLEN *)ckalloc((stmt->num_params + 1) * sizeof(SQLLEN));
+    SQLLEN row_width = 0;
+    int count;
+    
+    memset(widths, 0, (stmt->num_params + 1) * sizeof(SQLLEN));
+    for (count = 0; count < limit; count++) {
+        for (int p = 0; p < stmt->num_params; p++) {
+            Tcl_Obj *value;
+            int len;
+            
+            Tcl_ListObjIndex(NULL, rows[first + count], p, &value);
+            Tcl_GetStringFromObj(value, &len);
+            if (len + 1 > widths[p]) {
+                row_width += len + 1 - widths[p];
+                widths[p] = len + 1;
+            }
+        }
+        if (count > 0 && row_width * (count + 1) > IFX_MAX_ROWSET_BYTES) {
+            break;
+        }
+    }
+    ckfree((char *)widths);
+    return count;
+}
+
+/* Bind rows start .. start+count-1 of column-wise parameter arrays
+ * (buffers[p] holds widths[p] bytes per row, inds[p] the lengths or
+ * SQL_NULL_DATA) and execute them as one batch. The status of each row is
+ * left in row_status, the number of rows the driver got to in *processed,
+ * and rows affected are added to *affected. Returns what SQLExecute (or a
+ * failing SQLBindParameter) returned, with its message in error_buf if it
+ * failed; the statement is ready for the next batch either way. Does not
+ * touch an interp, so load threads can use it. */
+static SQLRETURN run_batch(IfxStatement *stmt, char **buffers, const SQLLEN *widths,
+                           SQLLEN **inds, int start, int count, SQLUSMALLINT *row_status,
+                           SQLULEN *processed, SQLLEN *affected,
+                           char *error_buf, size_t size) {
+    SQLLEN row_count = 0;
+    SQLRETURN ret = SQL_SUCCESS;
+    
+    *processed = 0;
+    for (int p = 0; p < stmt->num_params; p++) {
+        SQLULEN col_size = stmt->param_sizes[p];
+        
+        if (col_size < (SQLULEN)(widths[p] - 1)) {
+            col_size = widths[p] - 1;
+        }
+        if (col_size == 0) {
+            col_size = 1;
+        }
+        ret = SQLBindParameter(stmt->hstmt, p+1, SQL_PARAM_INPUT, SQL_C_CHAR,
+                               stmt->param_types[p], col_size, stmt->param_digits[p],
+                               buffers[p] + start * widths[p], widths[p], inds[p] + start);
+        if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+            odbc_error_text(SQL_HANDLE_STMT, stmt->hstmt, ret, error_buf, size);
+            goto done;
+        }
+    }
+    
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)SQL_PARAM_BIND_BY_COLUMN, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)(SQLULEN)count, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAM_STATUS_PTR, row_status, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMS_PROCESSED_PTR, processed, 0);
+    for (int r = 0; r < count; r++) {
+        row_status[r] = SQL_PARAM_UNUSED;
+    }
+    
+    ret = SQLExecute(stmt->hstmt);
+    
+    /* Before another call on hstmt clears the diagnostics */
+    if (ret != SQL_SUCCESS && ret != SQL_NO_DATA) {
+        odbc_error_text(SQL_HANDLE_STMT, stmt->hstmt, ret, error_buf, size);
+    }
+    if (ret != SQL_NO_DATA && SQLRowCount(stmt->hstmt, &row_count) == SQL_SUCCESS &&
+        row_count > 0) {
+        *affected += row_count;
+    }
+    
+done:
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)1, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAM_STATUS_PTR, NULL, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMS_PROCESSED_PTR, NULL, 0);
+    SQLFreeStmt(stmt->hstmt, SQL_RESET_PARAMS);
+    return ret;
+}
+
+/* Execute one batch of rows[first .. first+count-1] (lists of parameter
+ * values) with column-wise parameter arrays. Adds the affected row count
+ * to *affected and the indexes of failed/unprocessed rows to errors and
+ * unused. Returns TCL_ERROR if the batch as a whole failed; all of its
+ * rows are then in errors. */
+static int execute_batch(Tcl_Interp *interp, IfxStatement *stmt, Tcl_Obj **rows,
+                         int first, int count, SQLLEN *affected,
+                         Tcl_Obj *errors, Tcl_Obj *unused, Tcl_Obj **message) {
+    int num_params = stmt->num_params;
+    char **buffers = (char **)ckalloc((num_params + 1) * sizeof(char *));
+    SQLLEN *widths = (SQLLEN *)ckalloc((num_params + 1) * sizeof(SQLLEN));
+    SQLLEN **inds = (SQLLEN **)ckalloc((num_params + 1) * sizeof(SQLLEN *));
+    SQLUSMALLINT *row_status = (SQLUSMALLINT *)ckalloc(count * sizeof(SQLUSMALLINT));
+    SQLULEN processed = 0;
+    char error_buf[1200];
+    SQLRETURN ret;
+    int status = TCL_ERROR;
+    int p, r;
+    
+    for (p = 0; p < num_params; p++) {
+        SQLLEN width = 1;
+        
+        /* One array element per row, as wide as the longest value */
+        for (r = 0; r < count; r++) {
+            Tcl_Obj *value;
+            int len;
+            
+            Tcl_ListObjIndex(NULL, rows[first + r], p, &value);
+            Tcl_GetStringFromObj(value, &len);
+            if (len + 1 > width) {
+                width = len + 1;
+            }
+        }
+        widths[p] = width;
+        buffers[p] = ckalloc(width * count);
+        inds[p] = (SQLLEN *)ckalloc(count * sizeof(SQLLEN));
+        
+        for (r = 0; r < count; r++) {
+            Tcl_Obj *value;
+            const char *bytes;
+            int len;
+            
+            Tcl_ListObjIndex(NULL, rows[first + r], p, &value);
+            bytes = Tcl_GetStringFromObj(value, &len);
+            memcpy(buffers[p] + r * width, bytes, len);
+            buffers[p][r * width + len] = '\0';
+            /* Same NULL rule as ifx::execute_prepared */
+            if (len == 0 && !is_char_type(stmt->param_types[p])) {
+                inds[p][r] = SQL_NULL_DATA;
+            } else {
+                inds[p][r] = len;
+            }
+        }
+    }
+    
+    ret = run_batch(stmt, buffers, widths, inds, 0, count, row_status, &processed,
+                    affected, error_buf, sizeof(error_buf));
+    
+    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO && ret != SQL_NO_DATA) {
+        /* Without a per-row error the whole batch failed (e.g. a
+         * constraint the driver checks before sending) */
+        int row_errors = 0;
+        for (r = 0; r < (int)processed && r < count; r++) {
+            if (row_status[r] == SQL_PARAM_ERROR) {
+                row_errors++;
+            }
+        }
+        if (row_errors == 0) {
+            if (*message == NULL) {
+                *message = Tcl_NewStringObj(error_buf, -1);
+                Tcl_IncrRefCount(*message);
+            }
+            for (r = 0; r < count; r++) {
+                Tcl_ListObjAppendElement(NULL, errors, Tcl_NewIntObj(first + r));
+            }
+            goto done;
+        }
+    }
+    
+    /* SQL_SUCCESS means every row went through */
+    for (r = 0; r < count && ret != SQL_SUCCESS && ret != SQL_NO_DATA; r++) {
+        if (row_status[r] == SQL_PARAM_ERROR) {
+            if (*message == NULL) {
+                *message = Tcl_NewStringObj(error_buf, -1);
+                Tcl_IncrRefCount(*message);
+            }
+            Tcl_ListObjAppendElement(NULL, errors, Tcl_NewIntObj(first + r));
+        } else if (row_status[r] == SQL_PARAM_UNUSED || r >= (int)processed) {
+            Tcl_ListObjAppendElement(NULL, unused, Tcl_NewIntObj(first + r));
+        }
+    }
+    status = TCL_OK;
+    
+done:
+    for (p = 0; p < num_params; p++) {
+        ckfree(buffers[p]);
+        ckfree((char *)inds[p]);
+    }
+    ckfree((char *)buffers);
+    ckfree((char *)widths);
+    ckfree((char *)inds);
+    ckfree((char *)row_status);
+    return status;
+}
+
+/* ifx::execute_many stmt_handle rows ?-batch n?
+ *
+ * Executes a prepared (INSERT/UPDATE/DELETE) statement once per element of
+ * rows, each a list of parameter values like for ifx::execute_prepared.
+ * Rows are sent n at a time (default 1000, fewer if their values would
+ * take more than IFX_MAX_ROWSET_BYTES) as parameter arrays
+ * (SQL_ATTR_PARAMSET_SIZE), so a batch is one SQLExecute and one round
+ * trip. A failing row does not stop the others; the result is a dict:
+ *
+ *   affected   rows affected in total (SQLRowCount)
+ *   errors     0-based indexes of rows that failed
+ *   unused     indexes of rows the driver did not process
+ *   message    diagnostic of the first failure (only if there were errors)
+ *
+ * A batch that fails as a whole (e.g. the connection is lost) stops the
+ * command: its rows are in errors and the rows after it in unused, while
+ * the batches before it have been executed (and committed, in autocommit
+ * mode). So errors and unused together are always the rows to send again.
+ */
+static int IfxExecuteMany_Cmd(ClientData clientData, Tcl_Interp *interp,
+                              int objc, Tcl_Obj *CONST objv[]) {
+    IfxStatement *stmt;
+    Tcl_Obj **rows;
+    Tcl_Obj *errors, *unused, *message = NULL;
+    Tcl_Obj *result_dict;
+    SQLLEN affected = 0;
+    int num_rows, batch = IFX_DEFAULT_BATCH_SIZE;
+    
+    if (objc != 3 && objc != 5) {
+        Tcl_WrongNumArgs(interp, 1, objv, "stmt_handle rows ?-batch n?");
+        return TCL_ERROR;
+    }
+    if (objc == 5) {
+        if (strcmp(Tcl_GetString(objv[3]), "-batch") != 0) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf("bad option \"%s\": must be -batch",
+                                                   Tcl_GetString(objv[3])));
+            return TCL_ERROR;
+        }
+        if (Tcl_GetIntFromObj(interp, objv[4], &batch) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (batch < 1) {
+            Tcl_SetResult(interp, "-batch must be at least 1", TCL_STATIC);
+            return TCL_ERROR;
+        }
+    }
+    
+    stmt = get_statement(interp, objv[1]);
+    if (!stmt) {
+        return TCL_ERROR;
+    }
+    if (Tcl_ListObjGetElements(interp, objv[2], &num_rows, &rows) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    for (int r = 0; r < num_rows; r++) {
+        int len;
+        if (Tcl_ListObjLength(interp, rows[r], &len) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (len != stmt->num_params) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                "wrong number of parameters in row %d: expected %d, got %d",
+                r, (int)stmt->num_params, len));
+            return TCL_ERROR;
+        }
+    }
+    
+    reset_statement(stmt);
+    
+    errors = Tcl_NewListObj(0, NULL);
+    unused = Tcl_NewListObj(0, NULL);
+    Tcl_IncrRefCount(errors);
+    Tcl_IncrRefCount(unused);
+    
+    for (int first = 0, count; first < num_rows; first += count) {
+        count = batch_rows(stmt, rows, first,
+                           num_rows - first < batch ? num_rows - first : batch);
+        stmt->stats.executes += count;
+        stmt->stats.round_trips++;
+        
+        if (execute_batch(interp, stmt, rows, first, count, &affected,
+                          errors, unused, &message) != TCL_OK) {
+            for (int r = first + count; r < num_rows; r++) {
+                Tcl_ListObjAppendElement(NULL, unused, Tcl_NewIntObj(r));
+            }
+            break;
+        }
+    }
+    
+    result_dict = Tcl_NewDictObj();
+    Tcl_DictObjPut(NULL, result_dict, Tcl_NewStringObj("affected", -1),
+                   Tcl_NewWideIntObj((Tcl_WideInt)affected));
+    Tcl_DictObjPut(NULL, result_dict, Tcl_NewStringObj("errors", -1), errors);
+    Tcl_DictObjPut(NULL, result_dict, Tcl_NewStringObj("unused", -1), unused);
+    if (message) {
+        Tcl_DictObjPut(NULL, result_dict, Tcl_NewStringObj("message", -1), message);
+        Tcl_DecrRefCount(message);
+    }
+    Tcl_DecrRefCount(errors);
+    Tcl_DecrRefCount(unused);
+    
+    Tcl_SetObjResult(interp, result_dict);
+    return TCL_OK;
+}
+
+/* Bulk load (ifx::load)
+ *
+ * Records are parsed from the channel in C into batches: the values of a
+ * batch sit one after the other in data, with the offset and length of
+ * each in offsets and lens, row by row. A batch is turned into column-wise
+ * parameter arrays and inserted with one run_batch, by the calling thread
+ * or, with -connections k, by k worker threads that each own a connection
+ * and take batches from a queue the calling thread fills.
+ */
+typedef struct IfxLoadBatch {
+    int count;                  /* rows */
+    int size;                   /* rows there is room for */
+    int num_cols;
+    Tcl_WideInt *records;       /* 1-based input record number of each row */
+    SQLLEN *offsets;
+    SQLLEN *lens;               /* length or SQL_NULL_DATA */
+    SQLLEN *widths;             /* longest value + 1 of each column */
+    SQLLEN row_width;           /* sum of widths */
+    char *data;
+    SQLLEN data_len;
+    SQLLEN data_size;
+    struct IfxLoadBatch *next;
+} IfxLoadBatch;
+
+/* Records that could not be loaded, and the message of the first */
+typedef struct {
+    Tcl_WideInt *records;
+    int count;
+    int size;
+    Tcl_WideInt first;
+    char message[1200];
+} IfxLoadErrors;
+
+typedef struct IfxLoad IfxLoad;
+
+/* A connection of a load with the INSERT prepared on it */
+typedef struct {
+    IfxLoad *load;
+    IfxConnection *conn;        /* the caller's, or opened for the load */
+    IfxStatement *stmt;
+    Tcl_ThreadId thread;
+    SQLLEN affected;
+    SQLUINTEGER autocommit;     /* setting before the load, restored after */
+    int manual_commit;          /* autocommit turned off for -commit */
+    Tcl_WideInt uncommitted;    /* rows since the last commit */
+    IfxLoadErrors errors;
+    char fatal[1200];           /* error that stops the load, "" if none */
+} IfxLoadWorker;
+
+struct IfxLoad {
+    int commit;                 /* commit every n rows, 0 = leave to the connection */
+    int num_workers;
+    int threads;                /* worker threads started */
+    IfxLoadWorker *workers;
+    
+    /* Batches waiting for a worker */
+    Tcl_Mutex mutex;
+    Tcl_Condition ready;        /* a batch was queued, or the input ended */
+    Tcl_Condition taken;        /* a batch was taken, or a worker stopped */
+    IfxLoadBatch *queue;
+    IfxLoadBatch *queue_tail;
+    int queued;
+    int input_done;
+    int failed;                 /* a worker stopped on an error */
+};
+
+/* Input side of a load */
+typedef struct {
+    Tcl_Channel chan;
+    int format;
+    char delimiter;
+    char *buf;
+    int pos;
+    int len;
+    int eof;
+    int failed;                 /* reading the channel failed */
+    Tcl_WideInt records;        /* records read so far */
+    int num_fields;             /* of the record just read */
+    int fields_size;
+    SQLLEN *field_offsets;      /* into the data of the current batch */
+    SQLLEN *field_lens;
+} IfxLoadInput;
+
+/* Input formats of ifx::load */
+static const char *load_formats[] = { "unload", "csv", NULL };
+enum { IFX_LOAD_UNLOAD, IFX_LOAD_CSV };
+
+/* Make room for rows of num_cols values in an empty batch */
+static void size_load_batch(IfxLoadBatch *batch, int num_cols) {
+    if (batch->offsets) {
+        ckfree((char *)batch->offsets);
+        ckfree((char *)batch->lens);
+        ckfree((char *)batch->widths);
+    }
+    batch->num_cols = num_cols;
+    batch->offsets = (SQLLEN *)ckalloc((size_t)batch->size * num_cols * sizeof(SQLLEN));
+    batch->lens = (SQLLEN *)ckalloc((size_t)batch->size * num_cols * sizeof(SQLLEN));
+    batch->widths = (SQLLEN *)ckalloc(num_cols * sizeof(SQLLEN));
+    for (int p = 0; p < num_cols; p++) {
+        batch->widths[p] = 1;
+    }
+    batch->row_width = num_cols;
+}
+
+static IfxLoadBatch *new_load_batch(int num_cols, int size) {
+    IfxLoadBatch *batch = (IfxLoadBatch *)ckalloc(sizeof(IfxLoadBatch));
+    
+    batch->count = 0;
+    batch->size = size;
+    batch->records = (Tcl_WideInt *)ckalloc(size * sizeof(Tcl_WideInt));
+    batch->offsets = NULL;
+    size_load_batch(batch, num_cols);
+    batch->data_size = IFX_LOAD_BLOCK;
+    batch->data = ckalloc(batch->data_size);
+    batch->data_len = 0;
+    batch->next = NULL;
+    return batch;
+}
+
+static void free_load_batch(IfxLoadBatch *batch) {
+    ckfree((char *)batch->records);
+    ckfree((char *)batch->offsets);
+    ckfree((char *)batch->lens);
+    ckfree((char *)batch->widths);
+    ckfree(batch->data);
+    ckfree((char *)batch);
+}
+
+static void add_load_error(IfxLoadErrors *errors, Tcl_WideInt record, const char *message) {
+    if (errors->count == errors->size) {
+        errors->size = errors->size ? errors->size * 2 : 16;
+        errors->records = (Tcl_WideInt *)ckrealloc((char *)errors->records,
+                                                   errors->size * sizeof(Tcl_WideInt));
+    }
+    errors->records[errors->count++] = record;
+    if (errors->first == 0 || record < errors->first) {
+        errors->first = record;
+        snprintf(errors->message, sizeof(errors->message), "%s", message);
+    }
+}
+
+/* Next byte of the input, or -1 at its end */
+static int load_getc(IfxLoadInput *in) {
+    if (in->pos == in->len) {
+        if (in->eof) {
+            return -1;
+        }
+        in->len = Tcl_Read(in->chan, in->buf, IFX_LOAD_BLOCK);
+        in->pos = 0;
+        if (in->len <= 0) {
+            in->failed = in->len < 0;
+            in->len = 0;
+            in->eof = 1;
+            return -1;
+        }
+    }
+    return (unsigned char)in->buf[in->pos++];
+}
+
+static void load_append(IfxLoadBatch *batch, int c) {
+    if (batch->data_len == batch->data_size) {
+        batch->data_size *= 2;
+        batch->data = ckrealloc(batch->data, batch->data_size);
+    }
+    batch->data[batch->data_len++] = (char)c;
+}
+
+/* End a field that started at offset start of the batch data */
+static void load_field(IfxLoadInput *in, IfxLoadBatch *batch, SQLLEN start, int is_null) {
+    if (in->num_fields == in->fields_size) {
+        in->fields_size *= 2;
+        in->field_offsets = (SQLLEN *)ckrealloc((char *)in->field_offsets,
+                                                in->fields_size * sizeof(SQLLEN));
+        in->field_lens = (SQLLEN *)ckrealloc((char *)in->field_lens,
+                                             in->fields_size * sizeof(SQLLEN));
+    }
+    in->field_offsets[in->num_fields] = start;
+    in->field_lens[in->num_fields] = is_null ? SQL_NULL_DATA : batch->data_len - start;
+    in->num_fields++;
+}
+
+/* Read the next record into in->field_* with its values appended to the
+ * data of batch. Empty lines are skipped. Returns 0 at end of input.
+ *
+ * unload: what dbaccess UNLOAD writes and LOAD reads. Fields end with the
+ * delimiter, which may also end the line; a backslash takes the next
+ * character (delimiter, backslash, newline) literally; an empty field is
+ * NULL and "\ " alone an empty string.
+ * csv: RFC 4180, quotes around fields with "" for a quote; an empty
+ * unquoted field is NULL and "" an empty string. */
+static int load_record(IfxLoadInput *in, IfxLoadBatch *batch) {
+    int c = load_getc(in);
+    
+    while (c == '\n') {
+        c = load_getc(in);
+    }
+    if (c < 0) {
+        return 0;
+    }
+    in->num_fields = 0;
+    
+    for (;;) {
+        SQLLEN start = batch->data_len;
+        int quoted = 0;
+        
+        if (in->format == IFX_LOAD_CSV) {
+            if (c == '"') {
+                quoted = 1;
+                for (;;) {
+                    c = load_getc(in);
+                    if (c == '"') {
+                        c = load_getc(in);
+                        if (c != '"') {
+                            break;
+                        }
+                    } else if (c < 0) {
+                        break;
+                    }
+                    load_append(batch, c);
+                }
+            }
+            /* Anything after a closing quote is kept as is */
+            while (c >= 0 && c != in->delimiter && c != '\n') {
+                load_append(batch, c);
+                c = load_getc(in);
+            }
+        } else {
+            int lone_space = 0;
+            
+            while (c >= 0 && c != in->delimiter && c != '\n') {
+                if (c == '\\') {
+                    c = load_getc(in);
+                    if (c < 0) {
+                        break;
+                    }
+                    lone_space = c == ' ' && batch->data_len == start;
+                    quoted = 1;
+                }
+                load_append(batch, c);
+                c = load_getc(in);
+            }
+            if (lone_space && batch->data_len == start + 1) {
+                batch->data_len = start;
+            }
+        }
+        load_field(in, batch, start, !quoted && batch->data_len == start);
+        
+        if (c != in->delimiter) {
+            break;
+        }
+        c = load_getc(in);
+        /* UNLOAD ends every field, the last too, with the delimiter */
+        if (in->format == IFX_LOAD_UNLOAD && (c == '\n' || c < 0)) {
+            break;
+        }
+    }
+    in->records++;
+    return 1;
+}
+
+/* Add the record just read to batch */
+static void load_add_row(IfxLoadInput *in, IfxLoadBatch *batch) {
+    SQLLEN *offsets = batch->offsets + (size_t)batch->count * batch->num_cols;
+    SQLLEN *lens = batch->lens + (size_t)batch->count * batch->num_cols;
+    
+    for (int p = 0; p < batch->num_cols; p++) {
+        offsets[p] = in->field_offsets[p];
+        lens[p] = in->field_lens[p];
+        if (lens[p] + 1 > batch->widths[p]) {
+            batch->row_width += lens[p] + 1 - batch->widths[p];
+            batch->widths[p] = lens[p] + 1;
+        }
+    }
+    batch->records[batch->count++] = in->records;
+}
+
+/* Insert the rows of a batch on the worker's connection. Rows the driver
+ * reports as failed are recorded; those after a failed row it did not
+ * get to are sent again. Commits every load->commit rows. Returns 0 if
+ * the load has to stop, with the reason in worker->fatal. */
+static int load_batch(IfxLoadWorker *worker, IfxLoadBatch *batch) {
+    IfxStatement *stmt = worker->stmt;
+    int num_cols = batch->num_cols;
+    int count = batch->count;
+    char **buffers = (char **)ckalloc(num_cols * sizeof(char *));
+    SQLLEN **inds = (SQLLEN **)ckalloc(num_cols * sizeof(SQLLEN *));
+    SQLUSMALLINT *row_status = (SQLUSMALLINT *)ckalloc(count * sizeof(SQLUSMALLINT));
+    char error_buf[1200];
+    int start = 0;
+    
+    for (int p = 0; p < num_cols; p++) {
+        SQLLEN width = batch->widths[p];
+        
+        buffers[p] = ckalloc(width * count);
+        inds[p] = (SQLLEN *)ckalloc(count * sizeof(SQLLEN));
+        for (int r = 0; r < count; r++) {
+            SQLLEN len = batch->lens[(size_t)r * num_cols + p];
+            
+            inds[p][r] = len;
+            if (len > 0) {
+                memcpy(buffers[p] + r * width,
+                       batch->data + batch->offsets[(size_t)r * num_cols + p], len);
+            }
+            buffers[p][r * width + (len > 0 ? len : 0)] = '\0';
+        }
+    }
+    
+    while (start < count && worker->fatal[0] == '\0') {
+        SQLULEN processed;
+        SQLRETURN ret;
+        int n = count - start;
+        int last = -1, row_errors = 0;
+        
+        ret = run_batch(stmt, buffers, batch->widths, inds, start, n, row_status,
+                        &processed, &worker->affected, error_buf, sizeof(error_buf));
+        if (ret == SQL_SUCCESS || ret == SQL_NO_DATA) {
+            break;
+        }
+        for (int r = 0; r < n && r < (int)processed; r++) {
+            if (row_status[r] != SQL_PARAM_UNUSED) {
+                last = r;
+            }
+            if (row_status[r] == SQL_PARAM_ERROR) {
+                row_errors++;
+            }
+        }
+        if (ret == SQL_SUCCESS_WITH_INFO && row_errors == 0) {
+            break;
+        }
+        if (row_errors == 0) {
+            /* The batch as a whole failed */
+            snprintf(worker->fatal, sizeof(worker->fatal), "%s", error_buf);
+            break;
+        }
+        for (int r = 0; r <= last; r++) {
+            if (row_status[r] == SQL_PARAM_ERROR || row_status[r] == SQL_PARAM_UNUSED) {
+                add_load_error(&worker->errors, batch->records[start + r], error_buf);
+            }
+        }
+        start += last + 1;
+    }
+    
+    for (int p = 0; p < num_cols; p++) {
+        ckfree(buffers[p]);
+        ckfree((char *)inds[p]);
+    }
+    ckfree((char *)buffers);
+    ckfree((char *)inds);
+    ckfree((char *)row_status);
+    
+    worker->uncommitted += count;
+    if (worker->fatal[0] == '\0' && worker->load->commit > 0 &&
+        worker->uncommitted >= worker->load->commit) {
+        SQLRETURN ret = SQLEndTran(SQL_HANDLE_DBC, worker->conn->hdbc, SQL_COMMIT);
+        if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+            odbc_error_text(SQL_HANDLE_DBC, worker->conn->hdbc, ret, worker->fatal,
+                            sizeof(worker->fatal));
+        }
+        worker->uncommitted = 0;
+    }
+    return worker->fatal[0] == '\0';
+}
+
+/* Body of a load thread: insert batches from the queue until the input
+ * ends or the load fails */
+static Tcl_ThreadCreateType load_worker(ClientData clientData) {
+    IfxLoadWorker *worker = (IfxLoadWorker *)clientData;
+    IfxLoad *load = worker->load;
+    
+    for (;;) {
+        IfxLoadBatch *batch;
+        int ok;
+        
+        Tcl_MutexLock(&load->mutex);
+        while (!load->queue && !load->input_done && !load->failed) {
+            Tcl_ConditionWait(&load->ready, &load->mutex, NULL);
+        }
+        batch = load->failed ? NULL : load->queue;
+        if (batch) {
+            load->queue = batch->next;
+            if (!load->queue) {
+                load->queue_tail = NULL;
+            }
+            load->queued--;
+            Tcl_ConditionNotify(&load->taken);
+        }
+        Tcl_MutexUnlock(&load->mutex);
+        if (!batch) {
+            break;
+        }
+        
+        ok = load_batch(worker, batch);
+        free_load_batch(batch);
+        if (!ok) {
+            Tcl_MutexLock(&load->mutex);
+            load->failed = 1;
+            Tcl_ConditionNotify(&load->ready);
+            Tcl_ConditionNotify(&load->taken);
+            Tcl_MutexUnlock(&load->mutex);
+            break;
+        }
+    }
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/* Hand a full batch to the workers, or insert it right here if there are
+ * none. Returns 0 once the load has failed. */
+static int dispatch_batch(IfxLoad *load, IfxLoadBatch *batch) {
+    int ok;
+    
+    if (load->num_workers == 1) {
+        ok = load_batch(&load->workers[0], batch);
+        free_load_batch(batch);
+        load->failed = !ok;
+        return ok;
+    }
+    
+    /* Two batches per worker in the queue keep them busy while the
+     * parser fills the next */
+    Tcl_MutexLock(&load->mutex);
+    while (load->queued >= 2 * load->num_workers && !load->failed) {
+        Tcl_ConditionWait(&load->taken, &load->mutex, NULL);
+    }
+    ok = !load->failed;
+    if (ok) {
+        if (load->queue_tail) {
+            load->queue_tail->next = batch;
+        } else {
+            load->queue = batch;
+        }
+        load->queue_tail = batch;
+        load->queued++;
+        Tcl_ConditionNotify(&load->ready);
+    }
+    Tcl_MutexUnlock(&load->mutex);
+    if (!ok) {
+        free_load_batch(batch);
+    }
+    return ok;
+}
+
+/* Whether hdbc is inside a transaction: autocommit is off, or a BEGIN
+ * WORK is open, which makes another BEGIN WORK fail with -535. The
+ * transaction the probe opens otherwise is rolled back at once. */
+static int in_transaction(SQLHDBC hdbc) {
+    SQLUINTEGER autocommit = SQL_AUTOCOMMIT_ON;
+    SQLHSTMT hstmt;
+    SQLRETURN ret;
+    int open = 0;
+    
+    SQLGetConnectAttr(hdbc, SQL_ATTR_AUTOCOMMIT, &autocommit, 0, NULL);
+    if (autocommit == SQL_AUTOCOMMIT_OFF) {
+        return 1;
+    }
+    
+    if (SQLAllocHandle(SQL_HANDLE_STMT, hdbc, &hstmt) != SQL_SUCCESS) {
+        return 0;
+    }
+    ret = SQLExecDirect(hstmt, (SQLCHAR *)"BEGIN WORK", SQL_NTS);
+    if (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
+        SQLFreeStmt(hstmt, SQL_CLOSE);
+        SQLExecDirect(hstmt, (SQLCHAR *)"ROLLBACK WORK", SQL_NTS);
+    } else {
+        SQLCHAR sqlstate[6];
+        SQLINTEGER native_error = 0;
+        
+        if (SQLGetDiagRec(SQL_HANDLE_STMT, hstmt, 1, sqlstate, &native_error,
+                          NULL, 0, NULL) != SQL_NO_DATA && native_error == -535) {
+            open = 1;
+        }
+    }
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    return open;
+}
+
+/* Prepare the INSERT on the connections of a load: the caller's and
+ * num_workers - 1 more opened with its connection string */
+static int start_load(Tcl_Interp *interp, IfxLoad *load, IfxConnection *conn,
+                      const char *sql, int num_cols) {
+    for (int i = 0; i < load->num_workers; i++) {
+        IfxLoadWorker *worker = &load->workers[i];
+        
+        if (i == 0) {
+            worker->conn = conn;
+        } else {
+            SQLHDBC hdbc;
+            
+            if (!conn->conn_str) {
+                Tcl_SetResult(interp, "-connections needs a connection made by "
+                              "ifx::connect or ifx::pool acquire", TCL_STATIC);
+                return TCL_ERROR;
+            }
+            if (driver_connect(interp, conn->conn_str, &hdbc) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            worker->conn = alloc_connection(hdbc, &conn->session);
+            worker->conn->opts = conn->opts;
+        }
+        
+        worker->stmt = prepare_statement(interp, worker->conn, sql);
+        if (!worker->stmt) {
+            return TCL_ERROR;
+        }
+        if (worker->stmt->num_params != num_cols) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                "INSERT takes %d values, the input has %d fields",
+                (int)worker->stmt->num_params, num_cols));
+            return TCL_ERROR;
+        }
+        if (load->commit > 0) {
+            SQLRETURN ret;
+            
+            /* Its commits would end the caller's transaction early */
+            if (i == 0 && in_transaction(conn->hdbc)) {
+                Tcl_SetResult(interp, "-commit can't be used inside a transaction",
+                              TCL_STATIC);
+                return TCL_ERROR;
+            }
+            worker->autocommit = SQL_AUTOCOMMIT_ON;
+            SQLGetConnectAttr(worker->conn->hdbc, SQL_ATTR_AUTOCOMMIT,
+                              &worker->autocommit, 0, NULL);
+            ret = SQLSetConnectAttr(worker->conn->hdbc, SQL_ATTR_AUTOCOMMIT,
+                                    (SQLPOINTER)SQL_AUTOCOMMIT_OFF, 0);
+            if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+                char error_buf[1200];
+                odbc_error_text(SQL_HANDLE_DBC, worker->conn->hdbc, ret, error_buf,
+                                sizeof(error_buf));
+                Tcl_SetResult(interp, error_buf, TCL_VOLATILE);
+                return TCL_ERROR;
+            }
+            worker->manual_commit = 1;
+        }
+    }
+    
+    if (load->num_workers > 1) {
+        for (int i = 0; i < load->num_workers; i++) {
+            if (Tcl_CreateThread(&load->workers[i].thread, load_worker, &load->workers[i],
+                                 TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE) != TCL_OK) {
+                Tcl_SetResult(interp, "Failed to start a thread for -connections",
+                              TCL_STATIC);
+                return TCL_ERROR;
+            }
+            load->threads++;
+        }
+    }
+    return TCL_OK;
+}
+
+/* Wait for the workers, commit (or, if the load failed, roll back) what
+ * they left uncommitted and close the statements and connections */
+static void finish_load(IfxLoad *load) {
+    if (load->threads > 0) {
+        Tcl_MutexLock(&load->mutex);
+        load->input_done = 1;
+        Tcl_ConditionNotify(&load->ready);
+        Tcl_MutexUnlock(&load->mutex);
+        for (int i = 0; i < load->threads; i++) {
+            int result;
+            Tcl_JoinThread(load->workers[i].thread, &result);
+        }
+    }
+    
+    while (load->queue) {
+        IfxLoadBatch *batch = load->queue;
+        load->queue = batch->next;
+        free_load_batch(batch);
+    }
+    for (int i = 0; i < IFX_LOAD_MAX_CONNECTIONS; i++) {
+        if (load->workers[i].fatal[0]) {
+            load->failed = 1;
+        }
+    }
+    
+    for (int i = 0; i < IFX_LOAD_MAX_CONNECTIONS; i++) {
+        IfxLoadWorker *worker = &load->workers[i];
+        
+        if (!worker->conn) {
+            continue;
+        }
+        if (worker->manual_commit) {
+            SQLRETURN ret = SQLEndTran(SQL_HANDLE_DBC, worker->conn->hdbc,
+                                       load->failed ? SQL_ROLLBACK : SQL_COMMIT);
+            if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO && !load->failed) {
+                odbc_error_text(SQL_HANDLE_DBC, worker->conn->hdbc, ret, worker->fatal,
+                                sizeof(worker->fatal));
+            }
+            SQLSetConnectAttr(worker->conn->hdbc, SQL_ATTR_AUTOCOMMIT,
+                              (SQLPOINTER)(SQLULEN)worker->autocommit, 0);
+        }
+        if (worker->stmt) {
+            free_statement(worker->stmt);
+        }
+        if (i > 0) {
+            release_connection(worker->conn);
+        }
+    }
+    Tcl_MutexFinalize(&load->mutex);
+    Tcl_ConditionFinalize(&load->ready);
+    Tcl_ConditionFinalize(&load->taken);
+}
+
+static int compare_records(const void *a, const void *b) {
+    Tcl_WideInt x = *(const Tcl_WideInt *)a, y = *(const Tcl_WideInt *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* ifx::load conn_handle table channel ?-format unload|csv? ?-delimiter char?
+ *     ?-columns list? ?-batch n? ?-commit n? ?-connections k?
+ *
+ * Inserts the records read from channel into table. Records are parsed
+ * in C (see load_record; -delimiter defaults to | for unload, , for csv)
+ * and sent n at a time (-batch, default 1000) as parameter arrays of an
+ * INSERT INTO table (columns) VALUES (?, ...). Without -columns every
+ * column of the table is filled, in order, and the first record tells
+ * how many there are. The channel is read with Tcl_Read: its translation
+ * applies but not its encoding, the bytes go to the driver as they are in
+ * the file (as with ifx::export, in the client locale).
+ *
+ * -commit n turns autocommit off for the load and commits after every n
+ * rows (rounded up to whole batches) and at the end; if the load fails,
+ * the rows since the last commit are rolled back. Autocommit is then set
+ * back as it was. As these commits would end a transaction of the caller,
+ * -commit is refused inside one (BEGIN WORK, or autocommit off). Without
+ * it each batch is committed as the connection does it.
+ *
+ * -connections k inserts with k connections at once: the caller's and
+ * k-1 more opened like it, each fed by a thread of its own while this
+ * thread parses. Row order across the connections is not kept, and
+ * -commit counts per connection.
+ *
+ * A record that fails (a constraint, a bad value, the wrong number of
+ * fields) does not stop the load. The result is a dict:
+ *
+ *   records    records read
+ *   affected   rows inserted
+ *   errors     1-based numbers of the records that failed, in order
+ *   message    diagnostic of the first failure (only if there were errors)
+ *
+ * An error that fails a whole batch (lost connection, missing table)
+ * stops the load and is raised.
+ */
+static int IfxLoad_Cmd(ClientData clientData, Tcl_Interp *interp,
+                       int objc, Tcl_Obj *CONST objv[]) {
+    static const char *load_options[] = {
+        "-format", "-delimiter", "-columns", "-batch", "-commit", "-connections", NULL
+    };
+    IfxConnection *conn;
+    IfxLoad load;
+    IfxLoadInput in;
+    IfxLoadErrors parse_errors;
+    IfxLoadBatch *batch = NULL;
+    Tcl_Obj *delimiter = NULL, *columns = NULL;
+    Tcl_Obj *result_dict, *errors;
+    Tcl_Obj **error_objv;
+    Tcl_WideInt *records;
+    SQLLEN affected = 0;
+    int batch_size = IFX_DEFAULT_BATCH_SIZE;
+    int num_cols = 0, num_errors, mode, status = TCL_OK;
+    const char *message = NULL, *fatal = NULL;
+    
+    if (objc < 4 || objc % 2 != 0) {
+        Tcl_WrongNumArgs(interp, 1, objv, "conn_handle table channel ?-format unload|csv? "
+                         "?-delimiter char? ?-columns list? ?-batch n? ?-commit n? "
+                         "?-connections k?");
+        return TCL_ERROR;
+    }
+    
+    conn = get_connection(interp, objv[1]);
+    if (!conn) {
+        return TCL_ERROR;
+    }
+    in.chan = Tcl_GetChannel(interp, Tcl_GetString(objv[3]), &mode);
+    if (in.chan == NULL) {
+        return TCL_ERROR;
+    }
+    if (!(mode & TCL_READABLE)) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("channel \"%s\" wasn't opened for reading",
+                                               Tcl_GetString(objv[3])));
+        return TCL_ERROR;
+    }
+    
+    memset(&load, 0, sizeof(load));
+    load.num_workers = 1;
+    in.format = IFX_LOAD_UNLOAD;
+    for (int i = 4; i < objc; i += 2) {
+        int index, value = 0;
+        
+        if (Tcl_GetIndexFromObj(interp, objv[i], load_options, "option", 0,
+                                &index) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        switch (index) {
+            case 0:
+                if (Tcl_GetIndexFromObj(interp, objv[i+1], load_formats, "format", 0,
+                                        &in.format) != TCL_OK) {
+                    return TCL_ERROR;
+                }
+                break;
+            case 1:
+                delimiter = objv[i+1];
+                break;
+            case 2:
+                if (Tcl_ListObjLength(interp, objv[i+1], &num_cols) != TCL_OK) {
+                    return TCL_ERROR;
+                }
+                columns = objv[i+1];
+                break;
+            default:
+                if (Tcl_GetIntFromObj(interp, objv[i+1], &value) != TCL_OK) {
+                    return TCL_ERROR;
+                }
+                if (index == 3) {
+                    if (value < 1) {
+                        Tcl_SetResult(interp, "-batch must be at least 1", TCL_STATIC);
+                        return TCL_ERROR;
+                    }
+                    batch_size = value;
+                } else if (index == 4) {
+                    if (value < 0) {
+                        Tcl_SetResult(interp, "-commit must be >= 0", TCL_STATIC);
+                        return TCL_ERROR;
+                    }
+                    load.commit = value;
+                } else {
+                    if (value < 1 || value > IFX_LOAD_MAX_CONNECTIONS) {
+                        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+                            "-connections must be between 1 and %d",
+                            IFX_LOAD_MAX_CONNECTIONS));
+                        return TCL_ERROR;
+                    }
+                    load.num_workers = value;
+                }
+                break;
+        }
+    }
+    if (delimiter) {
+        int len;
+        const char *text = Tcl_GetStringFromObj(delimiter, &len);
+        
+        if (len != 1 || text[0] == '"' || text[0] == '\\' || text[0] == '\n') {
+            Tcl_SetResult(interp, "-delimiter must be a single ASCII character "
+                          "other than quote, backslash or newline", TCL_STATIC);
+            return TCL_ERROR;
+        }
+        in.delimiter = text[0];
+    } else {
+        in.delimiter = in.format == IFX_LOAD_CSV ? ',' : '|';
+    }
+    
+    in.buf = ckalloc(IFX_LOAD_BLOCK);
+    in.pos = in.len = 0;
+    in.eof = in.failed = 0;
+    in.records = 0;
+    in.num_fields = 0;
+    in.fields_size = 64;
+    in.field_offsets = (SQLLEN *)ckalloc(in.fields_size * sizeof(SQLLEN));
+    in.field_lens = (SQLLEN *)ckalloc(in.fields_size * sizeof(SQLLEN));
+    memset(&parse_errors, 0, sizeof(parse_errors));
+    load.workers = (IfxLoadWorker *)ckalloc(IFX_LOAD_MAX_CONNECTIONS * sizeof(IfxLoadWorker));
+    memset(load.workers, 0, IFX_LOAD_MAX_CONNECTIONS * sizeof(IfxLoadWorker));
+    for (int i = 0; i < IFX_LOAD_MAX_CONNECTIONS; i++) {
+        load.workers[i].load = &load;
+    }
+    
+    for (;;) {
+        SQLLEN record_start;
+        
+        if (!batch) {
+            batch = new_load_batch(num_cols > 0 ? num_cols : 1, batch_size);
+        }
+        record_start = batch->data_len;
+        if (!load_record(&in, batch)) {
+            break;
+        }
+        
+        if (load.workers[0].stmt == NULL) {
+            Tcl_DString sql;
+            
+            /* Columns not named: the first record tells how many */
+            if (num_cols == 0) {
+                num_cols = in.num_fields;
+                size_load_batch(batch, num_cols);
+            }
+            
+            Tcl_DStringInit(&sql);
+            Tcl_DStringAppend(&sql, "INSERT INTO ", -1);
+            Tcl_DStringAppend(&sql, Tcl_GetString(objv[2]), -1);
+            if (columns) {
+                Tcl_Obj **names;
+                int n;
+                
+                Tcl_ListObjGetElements(NULL, columns, &n, &names);
+                Tcl_DStringAppend(&sql, " (", -1);
+                for (int p = 0; p < n; p++) {
+                    Tcl_DStringAppend(&sql, p ? ", " : "", -1);
+                    Tcl_DStringAppend(&sql, Tcl_GetString(names[p]), -1);
+                }
+                Tcl_DStringAppend(&sql, ")", -1);
+            }
+            Tcl_DStringAppend(&sql, " VALUES (", -1);
+            for (int p = 0; p < num_cols; p++) {
+                Tcl_DStringAppend(&sql, p ? ", ?" : "?", -1);
+            }
+            Tcl_DStringAppend(&sql, ")", -1);
+            status = start_load(interp, &load, conn, Tcl_DStringValue(&sql), num_cols);
+            Tcl_DStringFree(&sql);
+            if (status != TCL_OK) {
+                break;
+            }
+        }
+        
+        if (in.num_fields != num_cols) {
+            char text[100];
+            snprintf(text, sizeof(text), "expected %d fields, got %d",
+                     num_cols, in.num_fields);
+            add_load_error(&parse_errors, in.records, text);
+            batch->data_len = record_start;
+            continue;
+        }
+        load_add_row(&in, batch);
+        
+        if (batch->count == batch->size ||
+            (batch->count + 1) * batch->row_width > IFX_MAX_ROWSET_BYTES) {
+            IfxLoadBatch *full = batch;
+            batch = NULL;
+            if (!dispatch_batch(&load, full)) {
+                break;
+            }
+        }
+    }
+    
+    if (status == TCL_OK && in.failed) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("error reading channel: %s",
+                                               Tcl_PosixError(interp)));
+        status = TCL_ERROR;
+    }
+    if (batch) {
+        if (status == TCL_OK && batch->count > 0 && !load.failed) {
+            dispatch_batch(&load, batch);
+        } else {
+            free_load_batch(batch);
+        }
+    }
+    if (status != TCL_OK) {
+        /* Rolls back what was loaded so far under -commit */
+        load.failed = 1;
+    }
+    finish_load(&load);
+    
+    /* Gather the outcome of all connections */
+    for (int i = 0; i < IFX_LOAD_MAX_CONNECTIONS; i++) {
+        IfxLoadWorker *worker = &load.workers[i];
+        
+        affected += worker->affected;
+        if (worker->fatal[0] && !fatal) {
+            fatal = worker->fatal;
+        }
+        /* The first error of a worker is the one its message is about */
+        for (int e = 0; e < worker->errors.count; e++) {
+            add_load_error(&parse_errors, worker->errors.records[e], worker->errors.message);
+        }
+    }
+    
+    if (status == TCL_OK && fatal) {
+        Tcl_SetResult(interp, (char *)fatal, TCL_VOLATILE);
+        status = TCL_ERROR;
+    }
+    if (status == TCL_OK) {
+        num_errors = parse_errors.count;
+        records = parse_errors.records;
+        if (num_errors > 0) {
+            qsort(records, num_errors, sizeof(Tcl_WideInt), compare_records);
+            message = parse_errors.message;
+        }
+        error_objv = (Tcl_Obj **)ckalloc((num_errors + 1) * sizeof(Tcl_Obj *));
+        for (int e = 0; e < num_errors; e++) {
+            error_objv[e] = Tcl_NewWideIntObj(records[e]);
+        }
+        errors = Tcl_NewListObj(num_errors, error_objv);
+        ckfree((char *)error_objv);
+        
+        result_dict = Tcl_NewDictObj();
+        Tcl_DictObjPut(NULL, result_dict, Tcl_NewStringObj("records", -1),
+                       Tcl_NewWideIntObj(in.records));
+        Tcl_DictObjPut(NULL, result_dict, Tcl_NewStringObj("affected", -1),
+                       Tcl_NewWideIntObj((Tcl_WideInt)affected));
+        Tcl_DictObjPut(NULL, result_dict, Tcl_NewStringObj("errors", -1), errors);
+        if (message) {
+            Tcl_DictObjPut(NULL, result_dict, Tcl_NewStringObj("message", -1),
+                           Tcl_NewStringObj(message, -1));
+        }
+        Tcl_SetObjResult(interp, result_dict);
+    }
+    
+    for (int i = 0; i < IFX_LOAD_MAX_CONNECTIONS; i++) {
+        if (load.workers[i].errors.records) {
+            ckfree((char *)load.workers[i].errors.records);
+        }
+    }
+    if (parse_errors.records) {
+        ckfree((char *)parse_errors.records);
+    }
+    ckfree((char *)load.workers);
+    ckfree(in.buf);
+    ckfree((char *)in.field_offsets);
+    ckfree((char *)in.field_lens);
+    return status;
+}
+
+/* ifx::close_statement stmt_handle */
+static int IfxCloseStatement_Cmd(ClientData clientData, Tcl_Interp *interp,
+                                 int objc, Tcl_Obj *CONST objv[]) {
+    IfxStatement *stmt;
+    
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "stmt_handle");
+        return TCL_ERROR;
+    }
+    
+    stmt = (IfxStatement *)close_handle(interp, objv[1], IFX_HANDLE_STMT);
+    if (stmt && stmt->async) {
+        /* Freed when the execute completes */
+        stmt->async->closed = 1;
+    } else if (stmt) {
+        free_statement(stmt);
+    }
+    
+    return TCL_OK;
+}
+
+/* ifx::fetch result_handle */
+static int IfxFetch_Cmd(ClientData clientData, Tcl_Interp *interp,
+                        int objc, Tcl_Obj *CONST objv[]) {
+    IfxResultSet *result;
+    int status;
+    
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "result_handle");
+        return TCL_ERROR;
+    }
+    
+    /* Get result set */
+    result = get_result(interp, objv[1]);
+    if (!result) {
+        return TCL_ERROR;
+    }
+    
+    /* Fetch next row (from the current rowset if there is one) */
+    status = next_row(interp, result);
+    if (status < 0) {
+        return TCL_ERROR;
+    }
+    if (status == 0) {
+        /* No more data */
+        Tcl_SetResult(interp, "", TCL_STATIC);
+        return TCL_OK;
+    }
+    
+    /* Build dictionary with column names and values */
+    Tcl_SetObjResult(interp, row_as_dict(interp, result));
+    return TCL_OK;
+}
+
+/* ifx::fetchlist result_handle
+ *
+ * Like ifx::fetch, but returns the row as a list of values in column
+ * order (see ifx::columns), which avoids building a dict per row.
+ * Returns an empty string when there are no more rows. */
+static int IfxFetchList_Cmd(ClientData clientData, Tcl_Interp *interp,
+                            int objc, Tcl_Obj *CONST objv[]) {
+    IfxResultSet *result;
+    int status;
+    
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "result_handle");
+        return TCL_ERROR;
+    }
+    
+    result = get_result(interp, objv[1]);
+    if (!result) {
+        return TCL_ERROR;
+    }
+    
+    status = next_row(interp, result);
+    if (status < 0) {
+        return TCL_ERROR;
+    }
+    if (status == 0) {
+        Tcl_SetResult(interp, "", TCL_STATIC);
+        return TCL_OK;
+    }
+    
+    Tcl_SetObjResult(interp, row_as_list(result));
+    return TCL_OK;
+}
+
+/* Look up a column by name or by 0-based index */
+static int find_column(Tcl_Interp *interp, IfxResultSet *result, Tcl_Obj *obj,
+                       int *index) {
+    const char *name = Tcl_GetString(obj);
+    
+    for (int i = 0; i < result->num_cols; i++) {
+        if (strcmp(result->cols[i].name, name) == 0) {
+            *index = i;
+            return TCL_OK;
+        }
+    }
+    if (Tcl_GetIntFromObj(NULL, obj, index) == TCL_OK &&
+        *index >= 0 && *index < result->num_cols) {
+        return TCL_OK;
+    }
+    Tcl_SetObjResult(interp, Tcl_ObjPrintf("no column \"%s\" in result set", name));
+    return TCL_ERROR;
+}
+
+/* Write the value of column i of the current row to chan, reading long
+ * values in IFX_GETDATA_CHUNK pieces so memory use does not depend on the
+ * value size. Returns the number of bytes written, -1 for NULL, or -2 on
+ * error (message left in interp). */
+static Tcl_WideInt stream_value(Tcl_Interp *interp, IfxResultSet *result, int i,
+                                Tcl_Channel chan) {
+    IfxColumn *col = &result->cols[i];
+    Tcl_WideInt total = 0;
+    SQLLEN indicator;
+    SQLRETURN ret;
+    char *buffer;
+    
+    if (col->data || (col->c_type != SQL_C_CHAR && col->c_type != SQL_C_BINARY)) {
+        /* Short value: nothing to gain from streaming */
+        Tcl_Obj *value = column_value(result, i);
+        int len;
+        const char *bytes;
+        
+        Tcl_IncrRefCount(value);
+        if (col->c_type == SQL_C_BINARY) {
+            bytes = (const char *)Tcl_GetByteArrayFromObj(value, &len);
+        } else {
+            bytes = Tcl_GetStringFromObj(value, &len);
+        }
+        /* Unbound columns here have fixed-size types, empty only if NULL */
+        if (col->data ? col->ind[result->cur_row] == SQL_NULL_DATA : len == 0) {
+            Tcl_DecrRefCount(value);
+            return -1;
+        }
+        if (Tcl_Write(chan, bytes, len) < 0) {
+            len = -1;
+        }
+        Tcl_DecrRefCount(value);
+        if (len < 0) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf("error writing channel: %s",
+                                                   Tcl_PosixError(interp)));
+            return -2;
+        }
+        return len;
+    }
+    
+    buffer = ckalloc(IFX_GETDATA_CHUNK);
+    for (;;) {
+        SQLLEN got;
+        
+        ret = SQLGetData(result->hstmt, i+1, col->c_type, buffer, IFX_GETDATA_CHUNK,
+                         &indicator);
+        if (ret == SQL_NO_DATA) {
+            break;
+        }
+        if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+            set_stmt_error(interp, result->hstmt, ret);
+            total = -2;
+            break;
+        }
+        if (indicator == SQL_NULL_DATA) {
+            total = -1;
+            break;
+        }
+        got = chunk_length(col->c_type, ret, indicator, IFX_GETDATA_CHUNK);
+        if (Tcl_Write(chan, buffer, (int)got) < 0) {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf("error writing channel: %s",
+                                                   Tcl_PosixError(interp)));
+            total = -2;
+            break;
+        }
+        total += got;
+        if (ret == SQL_SUCCESS) {
+            break;
+        }
+    }
+    ckfree(buffer);
+    return total;
+}
+
+/* ifx::fetchblob result_handle column channel
+ *
+ * Fetches the next row like ifx::fetch, but writes the value of one
+ * (typically TEXT/BYTE/LVARCHAR) column to channel in chunks instead of
+ * putting it in the row. In the returned dict that column holds the
+ * number of bytes written, or is empty if the value was NULL. column is
+ * a name or a 0-based index. Returns an empty string at end of data. */
+static int IfxFetchBlob_Cmd(ClientData clientData, Tcl_Interp *interp,
+                            int objc, Tcl_Obj *CONST objv[]) {
+    IfxResultSet *result;
+    Tcl_Channel chan;
+    Tcl_Obj *row_dict;
+    int mode, index, status;
+    
+    if (objc != 4) {
+        Tcl_WrongNumArgs(interp, 1, objv, "result_handle column channel");
+        return TCL_ERROR;
+    }
+    
+    result = get_result(interp, objv[1]);
+    if (!result) {
+        return TCL_ERROR;
+    }
+    if (find_column(interp, result, objv[2], &index) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    chan = Tcl_GetChannel(interp, Tcl_GetString(objv[3]), &mode);
+    if (chan == NULL) {
+        return TCL_ERROR;
+    }
+    if (!(mode & TCL_WRITABLE)) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("channel \"%s\" wasn't opened for writing",
+                                               Tcl_GetString(objv[3])));
+        return TCL_ERROR;
+    }
+    
+    status = next_row(interp, result);
+    if (status < 0) {
+        return TCL_ERROR;
+    }
+    if (status == 0) {
+        Tcl_SetResult(interp, "", TCL_STATIC);
+        return TCL_OK;
+    }
+    
+    /* Columns are read in order, as SQLGetData requires */
+    row_dict = Tcl_NewDictObj();
+    for (int i = 0; i < result->num_cols; i++) {
+        Tcl_Obj *value;
+        
+        if (i == index) {
+            Tcl_WideInt written = stream_value(interp, result, i, chan);
+            if (written == -2) {
+                Tcl_DecrRefCount(row_dict);
+                return TCL_ERROR;
+            }
+            value = written < 0 ? Tcl_NewObj() : Tcl_NewWideIntObj(written);
+        } else {
+            value = column_value(result, i);
+        }
+        Tcl_DictObjPut(NULL, row_dict, result->cols[i].name_obj, value);
+    }
+    
+    Tcl_SetObjResult(interp, row_dict);
+    return TCL_OK;
+}
+
+/* Row shapes for -as */
+static const char *row_formats[] = { "dicts", "lists", NULL };
+
+/* Fetch up to max_rows rows (all if max_rows < 0) as a list of dicts or
+ * lists. The rows are gathered in an array and the list is created once
+ * at its final size. Returns NULL on error. */
+static Tcl_Obj *collect_rows(Tcl_Interp *interp, IfxResultSet *result, int max_rows,
+                             int as_lists) {
+    int capacity = max_rows >= 0 && max_rows < (int)result->rowset_size * 4 ?
+                   max_rows : (int)result->rowset_size * 4;
+    Tcl_Obj **rows;
+    Tcl_Obj *list;
+    int n = 0, status = 0;
+    
+    if (capacity < 1) {
+        capacity = 1;
+    }
+    rows = (Tcl_Obj **)ckalloc(capacity * sizeof(Tcl_Obj *));
+    while (max_rows < 0 || n < max_rows) {
+        status = next_row(interp, result);
+        if (status <= 0) {
+            break;
+        }
+        if (n == capacity) {
+            capacity *= 2;
+            rows = (Tcl_Obj **)ckrealloc((char *)rows, capacity * sizeof(Tcl_Obj *));
+        }
+        rows[n++] = as_lists ? row_as_list(result) : row_as_dict(interp, result);
+    }
+    
+    list = Tcl_NewListObj(n, rows);
+    ckfree((char *)rows);
+    if (status < 0) {
+        /* Frees the rows gathered so far */
+        Tcl_IncrRefCount(list);
+        Tcl_DecrRefCount(list);
+        return NULL;
+    }
+    return list;
+}
+
+/* ifx::fetchmany result_handle ?n? ?-as dicts|lists?
+ *
+ * Returns up to n rows (default: one rowset) as a list of dicts or lists,
+ * or an empty list at end of data. Rows are block fetched with
+ * SQL_ATTR_ROW_ARRAY_SIZE into column-wise buffers, so the driver is
+ * called once per rowset instead of once per row and column.
+ */
+static int IfxFetchMany_Cmd(ClientData clientData, Tcl_Interp *interp,
+                            int objc, Tcl_Obj *CONST objv[]) {
+    IfxResultSet *result;
+    Tcl_Obj *rows;
+    int max_rows = 0;
+    int as_lists = 0;
+    int argi = 2;
+    
+    if (objc < 2 || objc > 5) {
+        Tcl_WrongNumArgs(interp, 1, objv, "result_handle ?n? ?-as dicts|lists?");
+        return TCL_ERROR;
+    }
+    
+    result = get_result(interp, objv[1]);
+    if (!result) {
+        return TCL_ERROR;
+    }
+    
+    if (argi < objc && Tcl_GetString(objv[argi])[0] != '-') {
+        if (Tcl_GetIntFromObj(interp, objv[argi], &max_rows) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        argi++;
+    }
+    if (argi < objc) {
+        if (objc - argi != 2 || strcmp(Tcl_GetString(objv[argi]), "-as") != 0) {
+            Tcl_WrongNumArgs(interp, 1, objv, "result_handle ?n? ?-as dicts|lists?");
+            return TCL_ERROR;
+        }
+        if (Tcl_GetIndexFromObj(interp, objv[argi+1], row_formats, "format", 0,
+                                &as_lists) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+    
+    if (max_rows <= 0) {
+        max_rows = (int)wanted_rowset(result);
+    }
+    
+    rows = collect_rows(interp, result, max_rows, as_lists);
+    if (rows == NULL) {
+        return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, rows);
+    return TCL_OK;
+}
+
+/* ifx::allrows result_handle ?-as dicts|lists?
+ *
+ * Fetches all remaining rows in one call and returns them as a list of
+ * dicts (default) or lists.
+ */
+static int IfxAllRows_Cmd(ClientData clientData, Tcl_Interp *interp,
+                          int objc, Tcl_Obj *CONST objv[]) {
+    IfxResultSet *result;
+    Tcl_Obj *rows;
+    int as_lists = 0;
+    
+    if (objc != 2 && objc != 4) {
+        Tcl_WrongNumArgs(interp, 1, objv, "result_handle ?-as dicts|lists?");
+        return TCL_ERROR;
+    }
+    
+    result = get_result(interp, objv[1]);
+    if (!result) {
+        return TCL_ERROR;
+    }
+    
+    if (objc == 4) {
+        if (strcmp(Tcl_GetString(objv[2]), "-as") != 0) {
+            Tcl_WrongNumArgs(interp, 1, objv, "result_handle ?-as dicts|lists?");
+            return TCL_ERROR;
+        }
+        if (Tcl_GetIndexFromObj(interp, objv[3], row_formats, "format", 0,
+                                &as_lists) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+    
+    rows = collect_rows(interp, result, -1, as_lists);
+    if (rows == NULL) {
+        return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, rows);
+    return TCL_OK;
+}
+
+/* ifx::fetchcolumns result_handle ?maxrows?
+ *
+ * Fetches up to maxrows (default all) remaining rows and returns them by
+ * column: a dict of column name -> list of values in row order. Each
+ * rowset is walked a column at a time straight from its bound buffers
+ * into one value array per column, so no row objects are built. At the
+ * end of data every column maps to an empty list.
+ */
+static int IfxFetchColumns_Cmd(ClientData clientData, Tcl_Interp *interp,
+                               int objc, Tcl_Obj *CONST objv[]) {
+    IfxResultSet *result;
+    Tcl_Obj ***values;
+    Tcl_Obj *dict;
+    int max_rows = -1, capacity, n = 0, status = 0;
+    
+    if (objc != 2 && objc != 3) {
+        Tcl_WrongNumArgs(interp, 1, objv, "result_handle ?maxrows?");
+        return TCL_ERROR;
+    }
+    
+    result = get_result(interp, objv[1]);
+    if (!result) {
+        return TCL_ERROR;
+    }
+    if (objc == 3) {
+        if (Tcl_GetIntFromObj(interp, objv[2], &max_rows) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (max_rows < 0) {
+            Tcl_SetResult(interp, "maxrows must be >= 0", TCL_STATIC);
+            return TCL_ERROR;
+        }
+    }
+    
+    capacity = max_rows >= 0 && max_rows < (int)result->rowset_size * 4 ?
+               max_rows : (int)result->rowset_size * 4;
+    if (capacity < 1) {
+        capacity = 1;
+    }
+    values = (Tcl_Obj ***)ckalloc((result->num_cols + 1) * sizeof(Tcl_Obj **));
+    for (int i = 0; i < result->num_cols; i++) {
+        values[i] = (Tcl_Obj **)ckalloc(capacity * sizeof(Tcl_Obj *));
+    }
+    
+    while (max_rows < 0 || n < max_rows) {
+        SQLULEN first, take;
+        
+        status = next_row(interp, result);
+        if (status <= 0) {
+            break;
+        }
+        
+        /* Take the rest of the rowset, from the row next_row handed out */
+        first = result->cur_row;
+        take = result->bound ? result->rows_fetched - first : 1;
+        if (max_rows >= 0 && take > (SQLULEN)(max_rows - n)) {
+            take = max_rows - n;
+        }
+        if (n + (int)take > capacity) {
+            while (n + (int)take > capacity) {
+                capacity *= 2;
+            }
+            for (int i = 0; i < result->num_cols; i++) {
+                values[i] = (Tcl_Obj **)ckrealloc((char *)values[i],
+                                                  capacity * sizeof(Tcl_Obj *));
+            }
+        }
+        
+        for (int i = 0; i < result->num_cols; i++) {
+            if (result->cols[i].data) {
+                for (SQLULEN r = 0; r < take; r++) {
+                    values[i][n + r] = bound_value(result, i, first + r);
+                }
+            } else {
+                /* SQLGetData columns limit the rowset to one row */
+                values[i][n] = column_value(result, i);
+            }
+        }
+        
+        if (result->bound) {
+            result->cur_row = first + take - 1;
+            result->next_row = first + take;
+        }
+        n += (int)take;
+    }
+    
+    dict = Tcl_NewDictObj();
+    for (int i = 0; i < result->num_cols; i++) {
+        Tcl_DictObjPut(NULL, dict, result->cols[i].name_obj,
+                       Tcl_NewListObj(n, values[i]));
+        ckfree((char *)values[i]);
+    }
+    ckfree((char *)values);
+    
+    if (status < 0) {
+        /* Frees the values gathered so far */
+        Tcl_IncrRefCount(dict);
+        Tcl_DecrRefCount(dict);
+        return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, dict);
+    return TCL_OK;
+}
+
+static int is_integer_type(SQLSMALLINT type) {
+    return type == SQL_BIT || type == SQL_TINYINT || type == SQL_SMALLINT ||
+           type == SQL_INTEGER || type == SQL_BIGINT;
+}
+
+/* Output formats of ifx::export */
+static const char *export_formats[] = { "csv", "tsv", "unload", "jsonl", NULL };
+enum { IFX_EXPORT_CSV, IFX_EXPORT_TSV, IFX_EXPORT_UNLOAD, IFX_EXPORT_JSONL };
+
+/* State of one ifx::export. Rows are formatted from the fetch buffers
+ * into buf, which goes to the channel with Tcl_WriteRaw once it holds
+ * IFX_EXPORT_BLOCK bytes. chunk receives values read with SQLGetData. */
+typedef struct {
+    Tcl_Channel chan;
+    int format;
+    char delimiter;
+    const char *null_text;
+    int null_len;
+    char *buf;
+    int len;
+    int size;
+    char *chunk;
+    int failed;                 /* a write failed, errno tells why */
+} IfxExport;
+
+static void export_flush(IfxExport *ex) {
+    int done = 0;
+    
+    while (!ex->failed && done < ex->len) {
+        int n = Tcl_WriteRaw(ex->chan, ex->buf + done, ex->len - done);
+        if (n <= 0) {
+            ex->failed = 1;
+        } else {
+            done += n;
+        }
+    }
+    ex->len = 0;
+}
+
+/* Room for n more bytes at the end of the buffer */
+static char *export_room(IfxExport *ex, SQLLEN n) {
+    if (ex->len + n > ex->size) {
+        export_flush(ex);
+        if (n > ex->size) {
+            ex->size = (int)n;
+            ex->buf = ckrealloc(ex->buf, ex->size);
+        }
+    }
+    return ex->buf + ex->len;
+}
+
+static void export_put(IfxExport *ex, const char *bytes, SQLLEN n) {
+    memcpy(export_room(ex, n), bytes, n);
+    ex->len += (int)n;
+}
+
+/* Append text escaped for the format: quotes doubled for csv (the caller
+ * adds the enclosing quotes), backslash escapes for the others */
+static void export_text(IfxExport *ex, const char *text, SQLLEN n) {
+    char *start = export_room(ex, n * 6);
+    char *out = start;
+    
+    for (SQLLEN k = 0; k < n; k++) {
+        unsigned char c = (unsigned char)text[k];
+        
+        switch (ex->format) {
+            case IFX_EXPORT_CSV:
+                if (c == '"') {
+                    *out++ = '"';
+                }
+                break;
+            case IFX_EXPORT_TSV:
+                if (c == '\\' || c == '\t' || c == '\n' || c == '\r' ||
+                    c == (unsigned char)ex->delimiter) {
+                    *out++ = '\\';
+                    c = c == '\t' ? 't' : c == '\n' ? 'n' : c == '\r' ? 'r' : c;
+                }
+                break;
+            case IFX_EXPORT_UNLOAD:
+                /* As dbaccess UNLOAD writes it: LOAD reads it back */
+                if (c == '\\' || c == '\n' || c == (unsigned char)ex->delimiter) {
+                    *out++ = '\\';
+                }
+                break;
+            default:
+                if (c == '"' || c == '\\') {
+                    *out++ = '\\';
+                } else if (c < 0x20) {
+                    *out++ = '\\';
+                    if (c == '\n' || c == '\r' || c == '\t') {
+                        c = c == '\n' ? 'n' : c == '\r' ? 'r' : 't';
+                    } else {
+                        /* Written out by hand: sprintf's NUL would land
+                         * one past the n * 6 reserved */
+                        *out++ = 'u';
+                        *out++ = '0';
+                        *out++ = '0';
+                        *out++ = "0123456789abcdef"[c >> 4];
+                        *out++ = "0123456789abcdef"[c & 0x0f];
+                        continue;
+                    }
+                }
+                break;
+        }
+        *out++ = (char)c;
+    }
+    ex->len += (int)(out - start);
+}
+
+static void export_hex(IfxExport *ex, const char *bytes, SQLLEN n) {
+    static const char digits[] = "0123456789ABCDEF";
+    char *out = export_room(ex, n * 2);
+    
+    for (SQLLEN k = 0; k < n; k++) {
+        *out++ = digits[((unsigned char)bytes[k]) >> 4];
+        *out++ = digits[((unsigned char)bytes[k]) & 0x0f];
+    }
+    ex->len += (int)(n * 2);
+}
+
+/* Does a csv field need quotes? Empty strings get them so they differ
+ * from NULL. */
+static int csv_quoted(const IfxExport *ex, const char *text, SQLLEN n) {
+    if (n == 0) {
+        return 1;
+    }
+    for (SQLLEN k = 0; k < n; k++) {
+        if (text[k] == '"' || text[k] == ex->delimiter ||
+            text[k] == '\n' || text[k] == '\r') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Text of a value that is not character or binary data, in text (size
+ * bytes, at least TCL_DOUBLE_SPACE). Returns its length and sets *number
+ * if it is a number rather than a string. */
+static int scalar_text(const IfxColumn *col, const char *data, const IfxOptions *opts,
+                       char *text, size_t size, int *number) {
+    *number = 1;
+    switch (col->c_type) {
+        case SQL_C_SBIGINT: {
+            SQLBIGINT value;
+            memcpy(&value, data, sizeof(value));
+            return snprintf(text, size, "%" TCL_LL_MODIFIER "d", (Tcl_WideInt)value);
+        }
+        case SQL_C_DOUBLE: {
+            SQLDOUBLE value;
+            memcpy(&value, data, sizeof(value));
+            Tcl_PrintDouble(NULL, (double)value, text);
+            *number = value - value == 0;
+            return (int)strlen(text);
+        }
+        default: {
+            Tcl_WideInt seconds;
+            SQLUINTEGER fraction;
+            int n = datetime_parts(col, data, text, size, &seconds, &fraction);
+            
+            if (opts->datetime == IFX_DT_ISO) {
+                *number = 0;
+                return n;
+            }
+            return snprintf(text, size, "%" TCL_LL_MODIFIER "d",
+                            epoch_value(opts->datetime, seconds, fraction));
+        }
+    }
+}
+
+/* Append column i of the current row as one field. Bound values are
+ * taken from their buffer; the others are read with SQLGetData into
+ * ex->chunk, piece by piece for long character and binary values. */
+static int export_value(Tcl_Interp *interp, IfxExport *ex, IfxResultSet *result, int i) {
+    IfxColumn *col = &result->cols[i];
+    SQLRETURN ret = SQL_SUCCESS;
+    const char *data;
+    SQLLEN len;
+    int quoted;
+    
+    if (col->data) {
+        data = bound_data(col, result->cur_row, &len);
+    } else {
+        SQLLEN indicator = SQL_NULL_DATA;
+        
+        ret = SQLGetData(result->hstmt, i+1, col->c_type, ex->chunk, IFX_GETDATA_CHUNK,
+                         &indicator);
+        if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO && ret != SQL_NO_DATA) {
+            set_stmt_error(interp, result->hstmt, ret);
+            return TCL_ERROR;
+        }
+        data = ex->chunk;
+        len = ret == SQL_NO_DATA || indicator == SQL_NULL_DATA ? SQL_NULL_DATA :
+              chunk_length(col->c_type, ret, indicator, IFX_GETDATA_CHUNK);
+    }
+    
+    if (len == SQL_NULL_DATA) {
+        if (ex->format == IFX_EXPORT_JSONL) {
+            export_put(ex, "null", 4);
+        } else {
+            export_put(ex, ex->null_text, ex->null_len);
+        }
+        return TCL_OK;
+    }
+    
+    if (col->c_type != SQL_C_CHAR && col->c_type != SQL_C_BINARY) {
+        char text[64];
+        int number;
+        int n = scalar_text(col, data, &result->opts, text, sizeof(text), &number);
+        
+        if (ex->format == IFX_EXPORT_JSONL && !number && col->c_type == SQL_C_DOUBLE) {
+            /* Inf and NaN have no JSON spelling */
+            export_put(ex, "null", 4);
+            return TCL_OK;
+        }
+        quoted = ex->format == IFX_EXPORT_JSONL && !number;
+        if (quoted) {
+            export_put(ex, "\"", 1);
+        }
+        export_put(ex, text, n);
+        if (quoted) {
+            export_put(ex, "\"", 1);
+        }
+        return TCL_OK;
+    }
+    
+    if (col->c_type == SQL_C_CHAR && result->opts.datetime >= IFX_DT_SECONDS &&
+        col->sql_type >= SQL_INTERVAL_YEAR &&
+        col->sql_type <= SQL_INTERVAL_MINUTE_TO_SECOND) {
+        Tcl_WideInt micros;
+        char text[32];
+        
+        if (interval_micros(col->sql_type, data, (int)len, &micros)) {
+            export_put(ex, text, sprintf(text, "%" TCL_LL_MODIFIER "d",
+                                         result->opts.datetime == IFX_DT_SECONDS ?
+                                         micros / 1000000 : micros));
+            return TCL_OK;
+        }
+    }
+    
+    /* A long value may go on in further chunks, so csv quotes it anyway */
+    switch (ex->format) {
+        case IFX_EXPORT_CSV:
+            quoted = ret == SQL_SUCCESS_WITH_INFO || csv_quoted(ex, data, len);
+            break;
+        case IFX_EXPORT_JSONL:
+            /* Integers as the driver formats them are JSON numbers too */
+            quoted = col->c_type == SQL_C_BINARY || !is_integer_type(col->sql_type);
+            break;
+        default:
+            quoted = 0;
+            /* An empty string is "\ " in UNLOAD files; nothing means NULL */
+            if (ex->format == IFX_EXPORT_UNLOAD && len == 0 && col->c_type == SQL_C_CHAR) {
+                export_put(ex, "\\ ", 2);
+                return TCL_OK;
+            }
+            break;
+    }
+    if (quoted) {
+        export_put(ex, "\"", 1);
+    }
+    for (;;) {
+        SQLLEN indicator;
+        
+        if (col->c_type == SQL_C_BINARY) {
+            export_hex(ex, data, len);
+        } else {
+            export_text(ex, data, len);
+        }
+        if (ret != SQL_SUCCESS_WITH_INFO) {
+            break;
+        }
+        ret = SQLGetData(result->hstmt, i+1, col->c_type, ex->chunk, IFX_GETDATA_CHUNK,
+                         &indicator);
+        if (ret == SQL_NO_DATA) {
+            break;
+        }
+        if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
+            set_stmt_error(interp, result->hstmt, ret);
+            return TCL_ERROR;
+        }
+        len = chunk_length(col->c_type, ret, indicator, IFX_GETDATA_CHUNK);
+    }
+    if (quoted) {
+        export_put(ex, "\"", 1);
+    }
+    return TCL_OK;
+}
+
+/* ifx::export result_handle channel ?-format csv|tsv|unload|jsonl?
+ *     ?-delimiter char? ?-null string?
+ *
+ * Writes all remaining rows to channel and returns how many there were.
+ * Rows are formatted in C straight from the rowset buffers, without a
+ * Tcl object per row or value, and written in IFX_EXPORT_BLOCK blocks
+ * with Tcl_WriteRaw: the bytes are the driver's, the channel encoding
+ * and translation are not applied.
+ *
+ *   csv     RFC 4180 fields, quoted when needed ("" for empty strings)
+ *   tsv     tab separated, with \t \n \r \\ escapes
+ *   unload  the Informix UNLOAD/LOAD format: delimiter | (DBDELIMITER)
+ *           after every field, backslash escapes
+ *   jsonl   one JSON object per line; -delimiter and -null don't apply
+ *
+ * -null is the text of NULL values (default empty). Binary values are
+ * written in hex, as UNLOAD does.
+ */
+static int IfxExport_Cmd(ClientData clientData, Tcl_Interp *interp,
+                         int objc, Tcl_Obj *CONST objv[]) {
+    static const char *export_options[] = { "-format", "-delimiter", "-null", NULL };
+    IfxResultSet *result;
+    IfxExport ex;
+    Tcl_WideInt rows = 0;
+    Tcl_Obj *delimiter = NULL;
+    int mode, status = 0;
+    
+    if (objc < 3 || objc % 2 != 1) {
+        Tcl_WrongNumArgs(interp, 1, objv, "result_handle channel "
+                         "?-format csv|tsv|unload|jsonl? ?-delimiter char? ?-null string?");
+        return TCL_ERROR;
+    }
+    
+    result = get_result(interp, objv[1]);
+    if (!result) {
+        return TCL_ERROR;
+    }
+    ex.chan = Tcl_GetChannel(interp, Tcl_GetString(objv[2]), &mode);
+    if (ex.chan == NULL) {
+        return TCL_ERROR;
+    }
+    if (!(mode & TCL_WRITABLE)) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("channel \"%s\" wasn't opened for writing",
+                                               Tcl_GetString(objv[2])));
+        return TCL_ERROR;
+    }
+    
+    ex.format = IFX_EXPORT_CSV;
+    ex.null_text = "";
+    ex.null_len = 0;
+    for (int i = 3; i < objc; i += 2) {
+        int index;
+        
+        if (Tcl_GetIndexFromObj(interp, objv[i], export_options, "option", 0,
+                                &index) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (index == 0) {
+            if (Tcl_GetIndexFromObj(interp, objv[i+1], export_formats, "format", 0,
+                                    &ex.format) != TCL_OK) {
+                return TCL_ERROR;
+            }
+        } else if (index == 1) {
+            delimiter = objv[i+1];
+        } else {
+            ex.null_text = Tcl_GetStringFromObj(objv[i+1], &ex.null_len);
+        }
+    }
+    if (delimiter) {
+        int len;
+        const char *text = Tcl_GetStringFromObj(delimiter, &len);
+        
+        if (len != 1 || text[0] == '"' || text[0] == '\\' ||
+            text[0] == '\n' || text[0] == '\r') {
+            Tcl_SetResult(interp, "-delimiter must be a single ASCII character "
+                          "other than quote, backslash or newline", TCL_STATIC);
+            return TCL_ERROR;
+        }
+        ex.delimiter = text[0];
+    } else {
+        ex.delimiter = ex.format == IFX_EXPORT_TSV ? '\t' :
+                       ex.format == IFX_EXPORT_UNLOAD ? '|' : ',';
+    }
+    
+    /* What was written through the channel buffer goes first. Raw writes
+     * go to the top of the channel stack, through any transforms pushed
+     * on it (zlib push etc.). */
+    if (Tcl_Flush(ex.chan) != TCL_OK) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("error writing channel: %s",
+                                               Tcl_PosixError(interp)));
+        return TCL_ERROR;
+    }
+    ex.chan = Tcl_GetTopChannel(ex.chan);
+    
+    ex.size = IFX_EXPORT_BLOCK + IFX_EXPORT_BLOCK / 4;
+    ex.buf = ckalloc(ex.size);
+    ex.len = 0;
+    ex.chunk = result->unbound_cols > 0 ? ckalloc(IFX_GETDATA_CHUNK) : NULL;
+    ex.failed = 0;
+    
+    while (!ex.failed) {
+        status = next_row(interp, result);
+        if (status <= 0) {
+            break;
+        }
+        for (int i = 0; i < result->num_cols && status > 0; i++) {
+            if (ex.format == IFX_EXPORT_JSONL) {
+                export_put(&ex, i == 0 ? "{\"" : ",\"", 2);
+                export_text(&ex, result->cols[i].name, strlen(result->cols[i].name));
+                export_put(&ex, "\":", 2);
+            } else if (i > 0) {
+                export_put(&ex, &ex.delimiter, 1);
+            }
+            if (export_value(interp, &ex, result, i) != TCL_OK) {
+                status = -1;
+            }
+        }
+        if (status < 0) {
+            break;
+        }
+        if (ex.format == IFX_EXPORT_JSONL) {
+            export_put(&ex, "}", 1);
+        } else if (ex.format == IFX_EXPORT_UNLOAD) {
+            export_put(&ex, &ex.delimiter, 1);
+        }
+        export_put(&ex, "\n", 1);
+        rows++;
+        if (ex.len >= IFX_EXPORT_BLOCK) {
+            export_flush(&ex);
+        }
+    }
+    if (status >= 0) {
+        export_flush(&ex);
     }
     
-    /* Create result set structure */
-    result = (IfxResultSet *)ckalloc(sizeof(IfxResultSet));
-    result->hstmt = hstmt;
+    ckfree(ex.buf);
+    if (ex.chunk) {
+        ckfree(ex.chunk);
+    }
+    if (ex.failed) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("error writing channel: %s",
+                                               Tcl_PosixError(interp)));
+        return TCL_ERROR;
+    }
+    if (status < 0) {
+        return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, Tcl_NewWideIntObj(rows));
+    return TCL_OK;
+}
+
+/* State of one ifx::foreach loop, carried between NRE callbacks */
+typedef struct {
+    Tcl_Obj *handle;            /* result handle, looked up again per row */
+    Tcl_Obj *var_name;
+    Tcl_Obj *script;
+    Tcl_Obj *row;               /* row object last stored in the variable */
+    int as_lists;
+    Tcl_WideInt rows;           /* rows the body was run for */
+    Tcl_WideInt limit;          /* stop after this many rows, -1 = no limit */
+} IfxForeachState;
+
+static int foreach_step(Tcl_Interp *interp, IfxForeachState *state);
+
+static void free_foreach_state(IfxForeachState *state) {
+    Tcl_DecrRefCount(state->handle);
+    Tcl_DecrRefCount(state->var_name);
+    Tcl_DecrRefCount(state->script);
+    if (state->row) {
+        Tcl_DecrRefCount(state->row);
+    }
+    ckfree((char *)state);
+}
+
+/* Store the current row in the loop variable. The previous row object is
+ * updated in place when only the loop and the variable still refer to it,
+ * which is the common case of a body that just reads the row. */
+static int set_foreach_row(Tcl_Interp *interp, IfxForeachState *state,
+                           IfxResultSet *result) {
+    Tcl_Obj *row = state->row;
     
-    /* Get number of columns */
-    SQLNumResultCols(hstmt, &result->num_cols);
+    if (row && row->refCount == 2 &&
+        Tcl_ObjGetVar2(interp, state->var_name, NULL, 0) == row) {
+        Tcl_DecrRefCount(row);
+        if (state->as_lists) {
+            for (int i = 0; i < result->num_cols; i++) {
+                result->row_objv[i] = column_value(result, i);
+            }
+            Tcl_ListObjReplace(NULL, row, 0, result->num_cols, result->num_cols,
+                               result->row_objv);
+        } else {
+            for (int i = 0; i < result->num_cols; i++) {
+                Tcl_DictObjPut(NULL, row, result->cols[i].name_obj,
+                               column_value(result, i));
+            }
+        }
+        Tcl_IncrRefCount(row);
+    } else {
+        if (row) {
+            Tcl_DecrRefCount(row);
+        }
+        row = state->as_lists ? row_as_list(result) : row_as_dict(interp, result);
+        Tcl_IncrRefCount(row);
+        state->row = row;
+    }
     
-    /* Get column names */
-    result->col_names = (char **)ckalloc(result->num_cols * sizeof(char *));
-    for (int i = 0; i < result->num_cols; i++) {
-        SQLCHAR col_name[256];
-        SQLSMALLINT name_len;
-        
-        SQLDescribeCol(hstmt, i+1, col_name, sizeof(col_name), &name_len,
-                      NULL, NULL, NULL, NULL);
+    if (Tcl_ObjSetVar2(interp, state->var_name, NULL, row, TCL_LEAVE_ERR_MSG) == NULL) {
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/* A loop left by break or return won't read the remaining rows, so close
+ * the cursor now instead of when the result set is closed; the server can
+ * then stop producing rows and free the cursor right away */
+static void discard_rows(Tcl_Interp *interp, IfxForeachState *state) {
+    IfxResultSet *result;
+    
+    result = (IfxResultSet *)lookup_handle(interp, state->handle, IFX_HANDLE_RESULT);
+    if (result && result->hstmt != SQL_NULL_HSTMT && !result->done) {
+        release_cursor(result);
+        result->done = 1;
+    }
+}
+
+/* Runs after each evaluation of the body */
+static int foreach_body_done(ClientData data[], Tcl_Interp *interp, int code) {
+    IfxForeachState *state = (IfxForeachState *)data[0];
+    
+    switch (code) {
+        case TCL_OK:
+        case TCL_CONTINUE:
+            Tcl_ResetResult(interp);
+            return foreach_step(interp, state);
+        case TCL_BREAK:
+            discard_rows(interp, state);
+            Tcl_SetObjResult(interp, Tcl_NewWideIntObj(state->limit < 0 ? state->rows : -1));
+            code = TCL_OK;
+            break;
+        case TCL_RETURN:
+            discard_rows(interp, state);
+            break;
+        case TCL_ERROR:
+            Tcl_AppendObjToErrorInfo(interp, Tcl_ObjPrintf(
+                "\n    (\"ifx::foreach\" body line %d)", Tcl_GetErrorLine(interp)));
+            break;
+    }
+    free_foreach_state(state);
+    return code;
+}
+
+/* Fetch the next row and schedule the body for it, or finish the loop */
+static int foreach_step(Tcl_Interp *interp, IfxForeachState *state) {
+    IfxResultSet *result;
+    int status;
+    
+    if (state->limit >= 0 && state->rows >= state->limit) {
+        Tcl_SetObjResult(interp, Tcl_NewWideIntObj(state->rows));
+        free_foreach_state(state);
+        return TCL_OK;
+    }
+    
+    /* The body may have closed the result set */
+    result = get_result(interp, state->handle);
+    if (!result) {
+        free_foreach_state(state);
+        return TCL_ERROR;
+    }
+    
+    status = next_row(interp, result);
+    if (status <= 0) {
+        if (status == 0) {
+            Tcl_SetObjResult(interp, Tcl_NewWideIntObj(state->rows));
+        }
+        free_foreach_state(state);
+        return status < 0 ? TCL_ERROR : TCL_OK;
+    }
+    
+    state->rows++;
+    if (set_foreach_row(interp, state, result) != TCL_OK) {
+        free_foreach_state(state);
+        return TCL_ERROR;
+    }
+    
+    Tcl_NRAddCallback(interp, foreach_body_done, state, NULL, NULL, NULL);
+    return Tcl_NREvalObj(interp, state->script, 0);
+}
+
+/* ifx::foreach result_handle ?-as dicts|lists? ?-limit n? varName script
+ *
+ * Runs script once per remaining row with the row stored in varName, in
+ * the caller's scope. Rows come from the rowset buffers like fetchmany,
+ * and the body is evaluated through the NRE so the loop adds no C stack
+ * per row. break, continue, return and errors behave as in foreach.
+ * Returns the number of rows the body was run for.
+ *
+ * -limit stops after n rows, leaving the rest for another call; a loop
+ * ended by break then returns -1 so that callers can tell it apart.
+ * Leaving the loop with break or return closes the cursor, discarding
+ * the rows not yet read.
+ */
+static int IfxForeach_NRCmd(ClientData clientData, Tcl_Interp *interp,
+                            int objc, Tcl_Obj *CONST objv[]) {
+    static const char *foreach_options[] = { "-as", "-limit", NULL };
+    IfxForeachState *state;
+    Tcl_WideInt limit = -1;
+    int as_lists = 0;
+    
+    if (objc < 4 || objc % 2 != 0) {
+        Tcl_WrongNumArgs(interp, 1, objv,
+                         "result_handle ?-as dicts|lists? ?-limit n? varName script");
+        return TCL_ERROR;
+    }
+    
+    if (get_result(interp, objv[1]) == NULL) {
+        return TCL_ERROR;
+    }
+    
+    for (int i = 2; i < objc - 2; i += 2) {
+        int index;
         
-        result->col_names[i] = (char *)ckalloc(name_len + 1);
-        strcpy(result->col_names[i], (char *)col_name);
+        if (Tcl_GetIndexFromObj(interp, objv[i], foreach_options, "option", 0,
+                                &index) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (index == 0) {
+            if (Tcl_GetIndexFromObj(interp, objv[i+1], row_formats, "format", 0,
+                                    &as_lists) != TCL_OK) {
+                return TCL_ERROR;
+            }
+        } else if (Tcl_GetWideIntFromObj(interp, objv[i+1], &limit) != TCL_OK) {
+            return TCL_ERROR;
+        } else if (limit < 0) {
+            Tcl_SetResult(interp, "-limit must be >= 0", TCL_STATIC);
+            return TCL_ERROR;
+        }
+    }
+    
+    state = (IfxForeachState *)ckalloc(sizeof(IfxForeachState));
+    state->handle = objv[1];
+    state->var_name = objv[objc-2];
+    state->script = objv[objc-1];
+    state->row = NULL;
+    state->as_lists = as_lists;
+    state->rows = 0;
+    state->limit = limit;
+    Tcl_IncrRefCount(state->handle);
+    Tcl_IncrRefCount(state->var_name);
+    Tcl_IncrRefCount(state->script);
+    
+    return foreach_step(interp, state);
+}
+
+static int IfxForeach_Cmd(ClientData clientData, Tcl_Interp *interp,
+                          int objc, Tcl_Obj *CONST objv[]) {
+    return Tcl_NRCallObjProc(interp, IfxForeach_NRCmd, clientData, objc, objv);
+}
+
+/* SQL type name of a column as reported by ifx::columns */
+static const char *sql_type_name(SQLSMALLINT sql_type) {
+    switch (sql_type) {
+        case SQL_CHAR:              return "char";
+        case SQL_VARCHAR:           return "varchar";
+        case SQL_LONGVARCHAR:       return "longvarchar";
+        case SQL_WCHAR:             return "wchar";
+        case SQL_WVARCHAR:          return "wvarchar";
+        case SQL_WLONGVARCHAR:      return "wlongvarchar";
+        case SQL_BIT:               return "bit";
+        case SQL_TINYINT:           return "tinyint";
+        case SQL_SMALLINT:          return "smallint";
+        case SQL_INTEGER:           return "integer";
+        case SQL_BIGINT:            return "bigint";
+        case SQL_REAL:              return "real";
+        case SQL_FLOAT:             return "float";
+        case SQL_DOUBLE:            return "double";
+        case SQL_DECIMAL:           return "decimal";
+        case SQL_NUMERIC:           return "numeric";
+        case SQL_DATE:
+        case SQL_TYPE_DATE:         return "date";
+        case SQL_TIME:
+        case SQL_TYPE_TIME:         return "time";
+        case SQL_TIMESTAMP:
+        case SQL_TYPE_TIMESTAMP:    return "timestamp";
+        case SQL_BINARY:            return "binary";
+        case SQL_VARBINARY:         return "varbinary";
+        case SQL_LONGVARBINARY:     return "longvarbinary";
+    }
+    if (sql_type >= SQL_INTERVAL_YEAR && sql_type <= SQL_INTERVAL_MINUTE_TO_SECOND) {
+        return "interval";
+    }
+    return "unknown";
+}
+
+/* ifx::columns result_handle
+ *
+ * Describes the columns of a result set as a list of dicts with keys
+ * name, type, precision, scale and nullable. The description is taken
+ * from SQLDescribeCol at execute time, so no row is fetched. */
+static int IfxColumns_Cmd(ClientData clientData, Tcl_Interp *interp,
+                          int objc, Tcl_Obj *CONST objv[]) {
+    IfxResultSet *result;
+    Tcl_Obj *list;
+    
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "result_handle");
+        return TCL_ERROR;
     }
     
-    /* Create result handle name */
-    snprintf(result_name, sizeof(result_name), "ifxresult%d", ++result_counter);
+    result = get_result(interp, objv[1]);
+    if (!result) {
+        return TCL_ERROR;
+    }
     
-    /* Store result in interpreter */
-    Tcl_SetAssocData(interp, result_name, NULL, (ClientData)result);
+    list = Tcl_NewListObj(0, NULL);
+    for (int i = 0; i < result->num_cols; i++) {
+        IfxColumn *col = &result->cols[i];
+        Tcl_Obj *info = Tcl_NewDictObj();
+        
+        Tcl_DictObjPut(NULL, info, Tcl_NewStringObj("name", -1), col->name_obj);
+        Tcl_DictObjPut(NULL, info, Tcl_NewStringObj("type", -1),
+                       Tcl_NewStringObj(sql_type_name(col->sql_type), -1));
+        Tcl_DictObjPut(NULL, info, Tcl_NewStringObj("precision", -1),
+                       Tcl_NewWideIntObj((Tcl_WideInt)col->size));
+        Tcl_DictObjPut(NULL, info, Tcl_NewStringObj("scale", -1),
+                       Tcl_NewIntObj(col->digits));
+        Tcl_DictObjPut(NULL, info, Tcl_NewStringObj("nullable", -1),
+                       Tcl_NewBooleanObj(col->nullable != SQL_NO_NULLS));
+        Tcl_ListObjAppendElement(NULL, list, info);
+    }
     
-    Tcl_SetResult(interp, result_name, TCL_VOLATILE);
+    Tcl_SetObjResult(interp, list);
     return TCL_OK;
 }
 
-/* ifx::fetch result_handle */
-static int IfxFetch_Cmd(ClientData clientData, Tcl_Interp *interp,
+/* ifx::stats handle
+ *
+ * Round trip accounting of a statement (all its executes so far, including
+ * the open result set) or of a result set, as a dict:
+ *
+ *   executes     SQLExecute/SQLExecDirect runs (rows of ifx::execute_many)
+ *   fetches      SQLFetch calls
+ *   rows         rows read from the driver
+ *   roundtrips   client/server round trips: prepare, execute or open, one
+ *                per fetch buffer of rows and close, less those saved by
+ *                OPTOFC; an estimate, as the driver does not report them
+ *   fetchbuffer  fetch buffer size of the session in bytes
+ *
+ * Result sets also report rowwidth, the estimated bytes per row in the
+ * fetch buffer, and rowset, the rows per SQLFetch. A large fetch buffer
+ * (ifx::connect -fetchbuffer) cuts the round trips of wide scans.
+ */
+static int IfxStats_Cmd(ClientData clientData, Tcl_Interp *interp,
                         int objc, Tcl_Obj *CONST objv[]) {
-    IfxResultSet *result;
-    char *result_name;
-    SQLRETURN ret;
-    Tcl_Obj *row_dict;
+    IfxStats stats;
+    IfxConnection *conn;
+    IfxResultSet *result = NULL;
+    Tcl_Obj *dict;
     
     if (objc != 2) {
-        Tcl_WrongNumArgs(interp, 1, objv, "result_handle");
+        Tcl_WrongNumArgs(interp, 1, objv, "handle");
         return TCL_ERROR;
     }
     
-    result_name = Tcl_GetString(objv[1]);
+    if (strncmp(Tcl_GetString(objv[1]), "ifxstmt", 7) == 0) {
+        IfxStatement *stmt = get_statement(interp, objv[1]);
+        if (!stmt) {
+            return TCL_ERROR;
+        }
+        stats = stmt->stats;
+        if (stmt->active && !stmt->active->cursor_closed) {
+            add_stats(&stats, &stmt->active->stats);
+        }
+        conn = stmt->conn;
+    } else {
+        result = get_result(interp, objv[1]);
+        if (!result) {
+            return TCL_ERROR;
+        }
+        stats = result->stats;
+        conn = result->conn;
+    }
     
-    /* Get result set */
-    result = (IfxResultSet *)Tcl_GetAssocData(interp, result_name, NULL);
-    if (!result) {
-        Tcl_SetResult(interp, "Invalid result handle", TCL_STATIC);
+    dict = Tcl_NewDictObj();
+    Tcl_DictObjPut(NULL, dict, Tcl_NewStringObj("executes", -1),
+                   Tcl_NewWideIntObj(stats.executes));
+    Tcl_DictObjPut(NULL, dict, Tcl_NewStringObj("fetches", -1),
+                   Tcl_NewWideIntObj(stats.fetches));
+    Tcl_DictObjPut(NULL, dict, Tcl_NewStringObj("rows", -1),
+                   Tcl_NewWideIntObj(stats.rows));
+    Tcl_DictObjPut(NULL, dict, Tcl_NewStringObj("roundtrips", -1),
+                   Tcl_NewWideIntObj(stats.round_trips));
+    Tcl_DictObjPut(NULL, dict, Tcl_NewStringObj("fetchbuffer", -1),
+                   Tcl_NewIntObj(conn->session.fetch_buffer > 0 ?
+                                 conn->session.fetch_buffer : IFX_DEFAULT_FETCH_BUFFER));
+    if (result) {
+        Tcl_DictObjPut(NULL, dict, Tcl_NewStringObj("rowwidth", -1),
+                       Tcl_NewWideIntObj((Tcl_WideInt)result->row_width));
+        Tcl_DictObjPut(NULL, dict, Tcl_NewStringObj("rowset", -1),
+                       Tcl_NewWideIntObj((Tcl_WideInt)(result->bound ? result->rowset_size
+                                                                     : 1)));
+    }
+    
+    Tcl_SetObjResult(interp, dict);
+    return TCL_OK;
+}
+
+/* Options understood by ifx::configure */
+static const char *option_names[] = {
+    "-rowsetsize", "-typed", "-datetime", "-timeout", "-maxrows", NULL
+};
+enum { OPT_ROWSETSIZE, OPT_TYPED, OPT_DATETIME, OPT_TIMEOUT, OPT_MAXROWS };
+
+/* Values of -datetime, in IFX_DT_* order */
+static const char *datetime_modes[] = { "text", "iso", "seconds", "microseconds", NULL };
+
+/* Current value of an option */
+static Tcl_Obj *get_option(const IfxOptions *opts, int index) {
+    switch (index) {
+        case OPT_ROWSETSIZE:
+            if (opts->rowset_size == 0) {
+                return Tcl_NewStringObj("auto", -1);
+            }
+            return Tcl_NewIntObj(opts->rowset_size);
+        case OPT_TYPED:
+            return Tcl_NewBooleanObj(opts->typed);
+        case OPT_DATETIME:
+            return Tcl_NewStringObj(datetime_modes[opts->datetime], -1);
+        case OPT_TIMEOUT:
+            return Tcl_NewIntObj(opts->timeout);
+        case OPT_MAXROWS:
+            return Tcl_NewIntObj(opts->max_rows);
+    }
+    return Tcl_NewObj();
+}
+
+/* Validate and store an option value */
+static int set_option(Tcl_Interp *interp, IfxOptions *opts, int index, Tcl_Obj *value_obj) {
+    int value;
+    
+    switch (index) {
+        case OPT_ROWSETSIZE:
+            if (strcmp(Tcl_GetString(value_obj), "auto") == 0) {
+                opts->rowset_size = 0;
+                break;
+            }
+            if (Tcl_GetIntFromObj(interp, value_obj, &value) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            if (value < 1) {
+                Tcl_SetResult(interp, "-rowsetsize must be at least 1 or auto", TCL_STATIC);
+                return TCL_ERROR;
+            }
+            opts->rowset_size = value;
+            break;
+        case OPT_TYPED:
+            if (Tcl_GetBooleanFromObj(interp, value_obj, &value) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            opts->typed = value;
+            break;
+        case OPT_DATETIME:
+            if (Tcl_GetIndexFromObj(interp, value_obj, datetime_modes, "-datetime mode",
+                                    0, &value) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            opts->datetime = value;
+            break;
+        case OPT_TIMEOUT:
+        case OPT_MAXROWS:
+            if (Tcl_GetIntFromObj(interp, value_obj, &value) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            if (value < 0) {
+                Tcl_SetObjResult(interp, Tcl_ObjPrintf("%s must be >= 0",
+                                                       option_names[index]));
+                return TCL_ERROR;
+            }
+            if (index == OPT_TIMEOUT) {
+                opts->timeout = value;
+            } else {
+                opts->max_rows = value;
+            }
+            break;
+    }
+    return TCL_OK;
+}
+
+/* ifx::configure handle ?-option? ?value -option value ...?
+ *
+ * Queries or sets options of a connection, statement or result handle.
+ * Statements take the options of their connection at prepare time,
+ * result sets those of their statement (or connection) at execute time.
+ * Options that decide how columns are bound (-typed, -datetime) only
+ * affect result sets created after the change.
+ *
+ *   -rowsetsize n    rows fetched per SQLFetch; auto takes as many as fit
+ *                    in the session's fetch buffer, by the described row width
+ *   -typed bool      return integer and float columns as Tcl numbers
+ *   -datetime mode   DATE/DATETIME as text (driver format), iso
+ *                    (YYYY-MM-DDTHH:MM:SS.F), seconds or microseconds since
+ *                    the epoch; day-to-second INTERVALs become a duration
+ *                    in seconds or microseconds in the last two modes
+ *   -timeout ms      cancel executes that take longer (SQL_ATTR_QUERY_TIMEOUT,
+ *                    rounded up to whole seconds); 0 waits forever
+ *   -maxrows n       have the server return at most n rows (SQL_ATTR_MAX_ROWS);
+ *                    0 returns all
+ *
+ * -timeout and -maxrows take effect on a statement's next execute.
+ */
+static int IfxConfigure_Cmd(ClientData clientData, Tcl_Interp *interp,
+                            int objc, Tcl_Obj *CONST objv[]) {
+    const char *name;
+    IfxOptions *opts = NULL;
+    IfxStatement *stmt = NULL;
+    int index;
+    
+    if (objc < 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "handle ?-option? ?value -option value ...?");
         return TCL_ERROR;
     }
     
-    /* Fetch next row */
-    ret = SQLFetch(result->hstmt);
+    name = Tcl_GetString(objv[1]);
+    if (strncmp(name, "ifxconn", 7) == 0) {
+        IfxConnection *conn = get_connection(interp, objv[1]);
+        if (conn) opts = &conn->opts;
+    } else if (strncmp(name, "ifxstmt", 7) == 0) {
+        stmt = get_statement(interp, objv[1]);
+        if (stmt) opts = &stmt->opts;
+    } else {
+        IfxResultSet *result = get_result(interp, objv[1]);
+        if (result) opts = &result->opts;
+    }
+    if (!opts) {
+        return TCL_ERROR;
+    }
     
-    if (ret == SQL_NO_DATA) {
-        /* No more data */
-        Tcl_SetResult(interp, "", TCL_STATIC);
+    /* Query all options */
+    if (objc == 2) {
+        Tcl_Obj *dict = Tcl_NewDictObj();
+        for (index = 0; option_names[index] != NULL; index++) {
+            Tcl_DictObjPut(NULL, dict, Tcl_NewStringObj(option_names[index], -1),
+                           get_option(opts, index));
+        }
+        Tcl_SetObjResult(interp, dict);
         return TCL_OK;
     }
     
-    if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO) {
-        Tcl_SetResult(interp, "Fetch failed", TCL_STATIC);
+    /* Query one option */
+    if (objc == 3) {
+        if (Tcl_GetIndexFromObj(interp, objv[2], option_names, "option", 0,
+                                &index) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        Tcl_SetObjResult(interp, get_option(opts, index));
+        return TCL_OK;
+    }
+    
+    if (objc % 2 != 0) {
+        Tcl_WrongNumArgs(interp, 1, objv, "handle ?-option? ?value -option value ...?");
         return TCL_ERROR;
     }
     
-    /* Build dictionary with column names and values */
-    row_dict = Tcl_NewDictObj();
+    for (int i = 2; i < objc; i += 2) {
+        if (Tcl_GetIndexFromObj(interp, objv[i], option_names, "option", 0,
+                                &index) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (set_option(interp, opts, index, objv[i+1]) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (stmt && (index == OPT_TIMEOUT || index == OPT_MAXROWS)) {
+            stmt->limits_changed = 1;
+        }
+    }
     
-    for (int i = 0; i < result->num_cols; i++) {
-        SQLCHAR buffer[4096];
-        SQLLEN indicator;
-        
-        ret = SQLGetData(result->hstmt, i+1, SQL_C_CHAR, buffer, 
-                        sizeof(buffer), &indicator);
-        
-        if (ret == SQL_SUCCESS) {
-            if (indicator == SQL_NULL_DATA) {
-                Tcl_DictObjPut(interp, row_dict,
-                              Tcl_NewStringObj(result->col_names[i], -1),
-                              Tcl_NewObj());
-            } else {
-                Tcl_DictObjPut(interp, row_dict,
-                              Tcl_NewStringObj(result->col_names[i], -1),
-                              Tcl_NewStringObj((char *)buffer, -1));
-            }
+    return TCL_OK;
+}
+
+/* ifx::cancel handle
+ *
+ * Cancels the execute or fetch running on a statement or result handle
+ * (SQLCancel), or the ifx::execute running on a connection handle; the
+ * interrupted command fails with the driver's error.
+ * Handles are looked up by name in the process-wide cancel table, so any
+ * thread may cancel a statement owned by another one, e.g. a watchdog
+ * given the handle name through thread::send. Returns 1 if the handle was
+ * found and 0 if it is not (or no longer) open, which is not an error as
+ * the statement may just have finished.
+ */
+static int IfxCancel_Cmd(ClientData clientData, Tcl_Interp *interp,
+                         int objc, Tcl_Obj *CONST objv[]) {
+    Tcl_HashEntry *entry = NULL;
+    
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "handle");
+        return TCL_ERROR;
+    }
+    
+    Tcl_MutexLock(&cancel_mutex);
+    if (cancel_initialized) {
+        entry = Tcl_FindHashEntry(&cancel_table, Tcl_GetString(objv[1]));
+        if (entry) {
+            SQLCancel((SQLHSTMT)Tcl_GetHashValue(entry));
         }
     }
+    Tcl_MutexUnlock(&cancel_mutex);
     
-    Tcl_SetObjResult(interp, row_dict);
+    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(entry != NULL));
     return TCL_OK;
 }
 
@@ -487,56 +5840,191 @@ static int IfxFetch_Cmd(ClientData clientData, Tcl_Interp *interp,
 static int IfxCloseResult_Cmd(ClientData clientData, Tcl_Interp *interp,
                               int objc, Tcl_Obj *CONST objv[]) {
     IfxResultSet *result;
-    char *result_name;
     
     if (objc != 2) {
         Tcl_WrongNumArgs(interp, 1, objv, "result_handle");
         return TCL_ERROR;
     }
     
-    result_name = Tcl_GetString(objv[1]);
-    
-    result = (IfxResultSet *)Tcl_GetAssocData(interp, result_name, NULL);
+    result = (IfxResultSet *)close_handle(interp, objv[1], IFX_HANDLE_RESULT);
     if (result) {
-        SQLFreeHandle(SQL_HANDLE_STMT, result->hstmt);
-        
-        for (int i = 0; i < result->num_cols; i++) {
-            ckfree(result->col_names[i]);
+        unregister_cancel(&result->cancel_entry);
+        if (result->stmt) {
+            /* Keep the prepared hstmt, just close its cursor */
+            release_cursor(result);
+            result->stmt->active = NULL;
+        } else if (result->hstmt != SQL_NULL_HSTMT) {
+            SQLFreeHandle(SQL_HANDLE_STMT, result->hstmt);
+            drop_connection_user(result->conn);
         }
-        ckfree((char *)result->col_names);
-        ckfree((char *)result);
         
-        Tcl_DeleteAssocData(interp, result_name);
+        free_result(result);
     }
     
     return TCL_OK;
 }
 
-/* ifx::disconnect conn_handle */
+/* ifx::disconnect conn_handle
+ *
+ * A connection from ifx::pool acquire is handed back to its pool. While
+ * statements or result sets of the connection are open (or executing
+ * with -async), that waits until the last of them is closed. */
 static int IfxDisconnect_Cmd(ClientData clientData, Tcl_Interp *interp,
                              int objc, Tcl_Obj *CONST objv[]) {
     IfxConnection *conn;
-    char *conn_name;
     
     if (objc != 2) {
         Tcl_WrongNumArgs(interp, 1, objv, "conn_handle");
         return TCL_ERROR;
     }
     
-    conn_name = Tcl_GetString(objv[1]);
-    
-    conn = (IfxConnection *)Tcl_GetAssocData(interp, conn_name, NULL);
+    conn = (IfxConnection *)close_handle(interp, objv[1], IFX_HANDLE_CONN);
     if (conn) {
-        if (conn->connected) {
-            SQLDisconnect(conn->hdbc);
+        release_connection(conn);
+    }
+    
+    return TCL_OK;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(const char **)a, *(const char **)b);
+}
+
+/* ifx::datasources ?-user|-system?
+ *
+ * Returns the sorted DSN names of the odbc.ini files (the DSN registry),
+ * of the user or system files only if asked.
+ */
+static int IfxDatasources_Cmd(ClientData clientData, Tcl_Interp *interp,
+                              int objc, Tcl_Obj *CONST objv[]) {
+    static const char *modes[] = { "-user", "-system", NULL };
+    const char **names;
+    int from = 0, to = IFX_INI_FILES, count = 0, size = 0;
+    Tcl_Obj *result;
+    
+    if (objc > 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "?-user|-system?");
+        return TCL_ERROR;
+    }
+    if (objc == 2) {
+        int mode;
+        if (Tcl_GetIndexFromObj(interp, objv[1], modes, "option", 0, &mode) != TCL_OK) {
+            return TCL_ERROR;
         }
-        SQLFreeHandle(SQL_HANDLE_DBC, conn->hdbc);
-        SQLFreeHandle(SQL_HANDLE_ENV, conn->henv);
-        ckfree((char *)conn);
-        
-        Tcl_DeleteAssocData(interp, conn_name);
+        if (mode == 0) {
+            to = IFX_INI_USER_FILES;
+        } else {
+            from = IFX_INI_USER_FILES;
+        }
+    }
+    
+    Tcl_MutexLock(&dsn_mutex);
+    refresh_dsn_registry();
+    for (int i = from; i < to; i++) {
+        size += ini_files[i].num_sections;
+    }
+    names = (const char **)ckalloc((size + 1) * sizeof(char *));
+    for (int i = from; i < to; i++) {
+        for (int j = 0; j < ini_files[i].num_sections; j++) {
+            const char *name = ini_files[i].sections[j];
+            if (strcmp(name, "ODBC Data Sources") != 0 && strcmp(name, "ODBC") != 0) {
+                names[count++] = name;
+            }
+        }
+    }
+    qsort(names, count, sizeof(char *), compare_names);
+    
+    result = Tcl_NewListObj(0, NULL);
+    for (int i = 0; i < count; i++) {
+        if (i == 0 || strcmp(names[i], names[i-1]) != 0) {
+            Tcl_ListObjAppendElement(NULL, result, Tcl_NewStringObj(names[i], -1));
+        }
+    }
+    Tcl_MutexUnlock(&dsn_mutex);
+    ckfree((char *)names);
+    
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+}
+
+/* Connections detached from their thread by ifx::detach, by handle name */
+static Tcl_HashTable detached;
+static int detached_initialized = 0;
+
+/* ifx::detach conn_handle
+ *
+ * Unregisters a connection from this interp so that ifx::attach can take
+ * it over in another thread, under the same handle name. Statements and
+ * result sets can't move with it, so it must have none open.
+ */
+static int IfxDetach_Cmd(ClientData clientData, Tcl_Interp *interp,
+                         int objc, Tcl_Obj *CONST objv[]) {
+    IfxConnection *conn;
+    Tcl_HashEntry *entry;
+    int is_new;
+    
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "conn_handle");
+        return TCL_ERROR;
+    }
+    
+    conn = get_connection(interp, objv[1]);
+    if (!conn) {
+        return TCL_ERROR;
+    }
+    if (conn->users > 0) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+            "connection \"%s\" has open statements or result sets",
+            Tcl_GetString(objv[1])));
+        return TCL_ERROR;
+    }
+    
+    close_handle(interp, objv[1], IFX_HANDLE_CONN);
+    
+    Tcl_MutexLock(&handle_mutex);
+    if (!detached_initialized) {
+        Tcl_InitHashTable(&detached, TCL_STRING_KEYS);
+        detached_initialized = 1;
+    }
+    entry = Tcl_CreateHashEntry(&detached, Tcl_GetString(objv[1]), &is_new);
+    Tcl_SetHashValue(entry, conn);
+    Tcl_MutexUnlock(&handle_mutex);
+    
+    return TCL_OK;
+}
+
+/* ifx::attach conn_handle
+ *
+ * Registers a connection detached by ifx::detach, possibly in another
+ * thread, in this interp. */
+static int IfxAttach_Cmd(ClientData clientData, Tcl_Interp *interp,
+                         int objc, Tcl_Obj *CONST objv[]) {
+    IfxConnection *conn = NULL;
+    Tcl_HashEntry *entry = NULL;
+    const char *name;
+    
+    if (objc != 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "conn_handle");
+        return TCL_ERROR;
+    }
+    name = Tcl_GetString(objv[1]);
+    
+    Tcl_MutexLock(&handle_mutex);
+    if (detached_initialized) {
+        entry = Tcl_FindHashEntry(&detached, name);
+    }
+    if (entry) {
+        conn = (IfxConnection *)Tcl_GetHashValue(entry);
+        Tcl_DeleteHashEntry(entry);
     }
+    Tcl_MutexUnlock(&handle_mutex);
     
+    if (!conn) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("no detached connection \"%s\"", name));
+        return TCL_ERROR;
+    }
+    
+    Tcl_SetObjResult(interp, register_handle(interp, name, IFX_HANDLE_CONN, conn));
     return TCL_OK;
 }
 
@@ -552,12 +6040,35 @@ int Ifxcli_Init(Tcl_Interp *interp) {
         return TCL_ERROR;
     }
     
+    bytearray_type = Tcl_GetObjType("bytearray");
+    
     /* Register commands */
     Tcl_CreateObjCommand(interp, "::ifx::connect", IfxConnect_Cmd, NULL, NULL);
     Tcl_CreateObjCommand(interp, "::ifx::execute", IfxExecute_Cmd, NULL, NULL);
     Tcl_CreateObjCommand(interp, "::ifx::fetch", IfxFetch_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::fetchlist", IfxFetchList_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::fetchblob", IfxFetchBlob_Cmd, NULL, NULL);
     Tcl_CreateObjCommand(interp, "::ifx::close_result", IfxCloseResult_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::prepare", IfxPrepare_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::execute_prepared", IfxExecutePrepared_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::execute_many", IfxExecuteMany_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::load", IfxLoad_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::close_statement", IfxCloseStatement_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::fetchmany", IfxFetchMany_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::allrows", IfxAllRows_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::fetchcolumns", IfxFetchColumns_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::export", IfxExport_Cmd, NULL, NULL);
+    Tcl_NRCreateCommand(interp, "::ifx::foreach", IfxForeach_Cmd, IfxForeach_NRCmd,
+                        NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::configure", IfxConfigure_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::columns", IfxColumns_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::stats", IfxStats_Cmd, NULL, NULL);
     Tcl_CreateObjCommand(interp, "::ifx::disconnect", IfxDisconnect_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::pool", IfxPool_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::detach", IfxDetach_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::attach", IfxAttach_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::cancel", IfxCancel_Cmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::ifx::datasources", IfxDatasources_Cmd, NULL, NULL);
     
     /* Provide package */
     if (Tcl_PkgProvide(interp, "ifxcli", "1.0") != TCL_OK) {
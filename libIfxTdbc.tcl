@@ -33,8 +33,22 @@ if {[info commands ::ifx::connect] ne ""} {
     rename ::ifx::connect ::ifx::_native_connect
     rename ::ifx::execute ::ifx::_native_execute
     rename ::ifx::fetch ::ifx::_native_fetch
+    rename ::ifx::fetchlist ::ifx::_native_fetchlist
+    rename ::ifx::fetchblob ::ifx::_native_fetchblob
     rename ::ifx::close_result ::ifx::_native_close_result
     rename ::ifx::disconnect ::ifx::_native_disconnect
+    rename ::ifx::prepare ::ifx::_native_prepare
+    rename ::ifx::execute_prepared ::ifx::_native_execute_prepared
+    rename ::ifx::execute_many ::ifx::_native_execute_many
+    rename ::ifx::load ::ifx::_native_load
+    rename ::ifx::close_statement ::ifx::_native_close_statement
+    rename ::ifx::fetchmany ::ifx::_native_fetchmany
+    rename ::ifx::allrows ::ifx::_native_allrows
+    rename ::ifx::fetchcolumns ::ifx::_native_fetchcolumns
+    rename ::ifx::export ::ifx::_native_export
+    rename ::ifx::foreach ::ifx::_native_foreach
+    rename ::ifx::configure ::ifx::_native_configure
+    rename ::ifx::columns ::ifx::_native_columns
 }
 
 namespace eval ::ifx::odbc {
@@ -46,49 +60,11 @@ namespace eval ::ifx::odbc {
 
 #
 # ifx::odbc::datasources ?-system|-user?
-# Returns list of available data sources
+# Returns list of available data sources, from the odbc.ini files that
+# ifx::connect reads (parsed once and cached, see ifx::datasources)
 #
 proc ::ifx::odbc::datasources {args} {
-    set mode ""
-    if {[llength $args] > 0} {
-        set mode [lindex $args 0]
-    }
-    
-    # Parse odbc.ini files to find DSN names
-    set datasources {}
-    set ini_files {}
-    
-    if {$mode eq "" || $mode eq "-user"} {
-        set home [file normalize ~]
-        if {[file exists "$home/.odbc.ini"]} {
-            lappend ini_files "$home/.odbc.ini"
-        }
-    }
-    
-    if {$mode eq "" || $mode eq "-system"} {
-        if {[file exists "/etc/odbc.ini"]} {
-            lappend ini_files "/etc/odbc.ini"
-        }
-    }
-    
-    foreach ini_file $ini_files {
-        if {[catch {open $ini_file r} fh]} {
-            continue
-        }
-        
-        while {[gets $fh line] >= 0} {
-            set line [string trim $line]
-            if {[string match {\[*\]} $line]} {
-                set dsn [string range $line 1 end-1]
-                if {$dsn ne "ODBC Data Sources" && $dsn ne "ODBC"} {
-                    lappend datasources $dsn
-                }
-            }
-        }
-        close $fh
-    }
-    
-    return [lsort -unique $datasources]
+    return [::ifx::datasources {*}$args]
 }
 
 #
@@ -116,7 +92,36 @@ namespace eval ::ifx::odbc::connection {
         -isolation "" \
         -readonly 0 \
         -timeout 0 \
+        -maxrows 0 \
+        -fetchbuffer 0 \
+        -optofc 0 \
+        -rowsetsize 256 \
+        -stmtcache 0 \
+        -typed 0 \
+        -datetime text \
     ]
+    
+    # Options implemented by the native layer (ifx::configure)
+    variable nativeOptions {-rowsetsize -typed -datetime -timeout -maxrows}
+    
+    # Session options, only taken when connecting (ifx::connect)
+    variable connectOptions {-fetchbuffer -optofc}
+}
+
+# Static helper: The objects of a list that still exist, so long-lived
+# connections and cached statements don't collect the names of closed ones
+proc ::ifx::odbc::connection::LiveObjects {objects} {
+    return [lmap obj $objects {
+        if {![info object isa object $obj]} continue
+        set obj
+    }]
+}
+
+# Static helper: Check whether an execute failed because the statement's
+# plan no longer matches the schema (table/column dropped, altered or
+# renamed, SPL routine no longer valid)
+proc ::ifx::odbc::connection::IsSchemaError {message} {
+    return [regexp {\[42S[02]2\]|\((-206|-217|-710|-721)\)} $message]
 }
 
 # Static helper: Parse ODBC-style connection string
@@ -156,6 +161,9 @@ oo::class create ::ifx::odbc::connection {
     variable conn_string
     variable options
     variable statements
+    variable stmt_cache
+    variable cache_busy
+    variable cache_stats
     
     # Class method: create named connection (static)
     self method create {name connString args} {
@@ -174,17 +182,29 @@ oo::class create ::ifx::odbc::connection {
     constructor {connString args} {
         set conn_string $connString
         set statements {}
+        set stmt_cache {}
+        set cache_busy {}
+        set cache_stats [dict create hits 0 misses 0 evictions 0 invalidations 0]
         
         # Copy default options from class-level variable
         set options $::ifx::odbc::connection::defaultOptions
+        set pool ""
         
         foreach {opt val} $args {
             if {[dict exists $options $opt]} {
                 dict set options $opt $val
+            } elseif {$opt eq "-pool"} {
+                # Take the connection from an ifx::pool, which gets it back
+                # when this connection is closed
+                set pool $val
             } else {
-                error "unknown option \"$opt\": must be -encoding, -isolation, -readonly, or -timeout"
+                error "unknown option \"$opt\": must be -datetime, -encoding, -fetchbuffer, -isolation, -maxrows, -optofc, -pool, -readonly, -rowsetsize, -stmtcache, -timeout, or -typed"
             }
         }
+        if {![string is entier -strict [dict get $options -stmtcache]]
+                || [dict get $options -stmtcache] < 0} {
+            error "-stmtcache must be a non-negative integer"
+        }
         
         # Parse connection string using static helper
         set parsed [::ifx::odbc::connection::ParseConnectionString $connString]
@@ -209,12 +229,24 @@ oo::class create ::ifx::odbc::connection {
         }
         
         # Create the native connection
+        set login [list $dsn]
         if {$user ne "" && $password ne ""} {
-            set conn_handle [::ifx::_native_connect $dsn $user $password]
+            lappend login $user $password
         } elseif {$user ne ""} {
-            set conn_handle [::ifx::_native_connect $dsn $user]
+            lappend login $user
+        }
+        foreach opt $::ifx::odbc::connection::connectOptions {
+            lappend login $opt [dict get $options $opt]
+        }
+        if {$pool ne ""} {
+            set conn_handle [::ifx::pool acquire $pool {*}$login]
         } else {
-            set conn_handle [::ifx::_native_connect $dsn]
+            set conn_handle [::ifx::_native_connect {*}$login]
+        }
+        
+        # Pass native options down to the connection handle
+        foreach opt $::ifx::odbc::connection::nativeOptions {
+            ::ifx::_native_configure $conn_handle $opt [dict get $options $opt]
         }
     }
     
@@ -237,10 +269,108 @@ oo::class create ::ifx::odbc::connection {
     # Returns a statement object
     method prepare {sql} {
         set stmt [::ifx::odbc::statement new [self] $conn_handle $sql]
+        set statements [::ifx::odbc::connection::LiveObjects $statements]
         lappend statements $stmt
         return $stmt
     }
     
+    # Statement cache for ad-hoc allrows/foreach
+    #
+    # With -stmtcache n the statements prepared for the SQL text of
+    # allrows/foreach are kept (up to n, least recently used dropped first)
+    # and executed again on the next call with the same text, instead of
+    # being prepared and closed every time. A cached statement in use by an
+    # outer foreach is never re-executed (that would close its cursor);
+    # the inner call gets a statement of its own. A cached statement that
+    # fails with a schema error (see IsSchemaError) is dropped and the SQL
+    # prepared once more.
+    
+    # Returns {stmt cached} for sql; release it with ReleaseStatement
+    method AcquireStatement {sql} {
+        if {[dict exists $stmt_cache $sql]} {
+            set stmt [dict get $stmt_cache $sql]
+            if {![dict exists $cache_busy $stmt]} {
+                # Move to the most recently used end
+                dict unset stmt_cache $sql
+                dict set stmt_cache $sql $stmt
+                dict set cache_busy $stmt 1
+                dict incr cache_stats hits
+                return [list $stmt 1]
+            }
+        }
+        dict incr cache_stats misses
+        set stmt [my prepare $sql]
+        if {[dict get $options -stmtcache] > 0 && ![dict exists $stmt_cache $sql]} {
+            dict set stmt_cache $sql $stmt
+            dict set cache_busy $stmt 1
+            my TrimCache [dict get $options -stmtcache]
+            return [list $stmt 1]
+        }
+        return [list $stmt 0]
+    }
+    
+    # Done with a statement from AcquireStatement: closed unless it is
+    # (still) in the cache
+    method ReleaseStatement {sql stmt cached} {
+        if {$stmt eq ""} {
+            return
+        }
+        dict unset cache_busy $stmt
+        if {!$cached || ![dict exists $stmt_cache $sql]
+                || [dict get $stmt_cache $sql] ne $stmt} {
+            $stmt close
+        }
+    }
+    
+    # Drop the cached statement for sql; closed now unless in use
+    method DropStatement {sql} {
+        if {[dict exists $stmt_cache $sql]} {
+            set stmt [dict get $stmt_cache $sql]
+            dict unset stmt_cache $sql
+            if {![dict exists $cache_busy $stmt]} {
+                $stmt close
+            }
+        }
+    }
+    
+    # Drop least recently used statements until at most size are cached
+    method TrimCache {size} {
+        set excess [expr {[dict size $stmt_cache] - $size}]
+        dict for {sql stmt} $stmt_cache {
+            if {$excess <= 0} break
+            my DropStatement $sql
+            dict incr cache_stats evictions
+            incr excess -1
+        }
+    }
+    
+    # Execute a statement from AcquireStatement. A schema error on a cached
+    # statement drops it and retries with a newly prepared one; the
+    # statement used is left in the stmtVar/cachedVar variables.
+    method ExecuteCached {sql stmtVar cachedVar} {
+        upvar 1 $stmtVar stmt $cachedVar cached
+        if {[catch {uplevel 1 [list $stmt execute]} rs opts]} {
+            if {!$cached || ![::ifx::odbc::connection::IsSchemaError $rs]} {
+                return -options $opts $rs
+            }
+            dict incr cache_stats invalidations
+            my DropStatement $sql
+            my ReleaseStatement $sql $stmt $cached
+            set stmt ""
+            set cached 0
+            lassign [my AcquireStatement $sql] stmt cached
+            set rs [uplevel 1 [list $stmt execute]]
+        }
+        return $rs
+    }
+    
+    # Statement cache counters: size, max, hits, misses, evictions and
+    # invalidations (cached statements dropped after a schema error)
+    method cachestats {} {
+        return [dict merge [dict create size [dict size $stmt_cache] \
+            max [dict get $options -stmtcache]] $cache_stats]
+    }
+    
     # Execute SQL directly and return resultset (convenience method)
     method allrows {args} {
         # Parse -as option
@@ -275,35 +405,23 @@ oo::class create ::ifx::odbc::connection {
             error "missing SQL statement"
         }
         
-        set stmt [my prepare $sql]
-        set rs [$stmt execute]
-        
-        set result {}
-        if {$as eq "lists"} {
-            while {1} {
-                set row [$rs nextlist]
-                if {$row eq ""} break
-                lappend result $row
-            }
-        } else {
-            while {1} {
-                set row [$rs nextdict]
-                if {$row eq ""} break
-                lappend result $row
-            }
+        lassign [my AcquireStatement $sql] stmt cached
+        if {[catch {my ExecuteCached $sql stmt cached} result opts] == 0} {
+            set rs $result
+            catch {$rs allrows -as $as} result opts
+            $rs close
         }
+        my ReleaseStatement $sql $stmt $cached
         
-        $rs close
-        $stmt close
-        
-        return $result
+        return -options $opts $result
     }
     
     # Execute SQL and iterate with foreach (TDBC compatible)
     method foreach {args} {
-        # Parse: ?-as dicts|lists? ?-columnsvariable varName? ?--? varName sql script
+        # Parse: ?-as dicts|lists? ?-columnsvariable varName? ?-chunk n? ?--? varName sql script
         set as "dicts"
         set columnsVar ""
+        set chunk ""
         set varName ""
         set sql ""
         set script ""
@@ -320,6 +438,10 @@ oo::class create ::ifx::odbc::connection {
                     incr i
                     set columnsVar [lindex $args $i]
                 }
+                -chunk {
+                    incr i
+                    set chunk [lindex $args $i]
+                }
                 -- {
                     incr i
                     break
@@ -342,50 +464,32 @@ oo::class create ::ifx::odbc::connection {
         
         lassign $remaining varName sql script
         
-        upvar 1 $varName row
+        set loop_options [list -as $as]
         if {$columnsVar ne ""} {
-            upvar 1 $columnsVar columns
+            lappend loop_options -columnsvariable $columnsVar
         }
-        
-        set stmt [my prepare $sql]
-        set rs [$stmt execute]
-        
-        if {$columnsVar ne ""} {
-            set columns [$rs columns]
+        if {$chunk ne ""} {
+            lappend loop_options -chunk $chunk
         }
         
-        set result ""
-        while {1} {
-            if {$as eq "lists"} {
-                set row [$rs nextlist]
-            } else {
-                set row [$rs nextdict]
-            }
-            
-            if {$row eq ""} break
-            
-            set code [catch {uplevel 1 $script} result opts]
-            switch $code {
-                0 { }
-                1 { 
-                    $rs close
-                    $stmt close
-                    return -options $opts $result 
-                }
-                2 { 
-                    $rs close
-                    $stmt close
-                    return -options $opts $result 
-                }
-                3 { break }
-                4 { continue }
-            }
+        lassign [my AcquireStatement $sql] stmt cached
+        if {[catch {my ExecuteCached $sql stmt cached} rs opts]} {
+            my ReleaseStatement $sql $stmt $cached
+            return -options $opts $rs
         }
         
+        # The resultset runs the loop in our caller's scope
+        set code [catch {uplevel 1 [list $rs foreach {*}$loop_options -- $varName $script]} \
+                      result opts]
+        
         $rs close
-        $stmt close
+        my ReleaseStatement $sql $stmt $cached
         
-        return $result
+        # A return in the script leaves our caller, not just this method
+        if {$code == 2} {
+            dict incr opts -level
+        }
+        return -options $opts $result
     }
     
     # Get list of tables (TDBC compatible)
@@ -495,6 +599,16 @@ oo::class create ::ifx::odbc::connection {
         ::ifx::_native_close_result $rs_handle
     }
     
+    # Bulk load records from a channel into table, parsed and inserted
+    # natively in batches (see ifx::load)
+    # load table channel ?-format unload|csv? ?-delimiter c? ?-columns list?
+    #     ?-batch n? ?-commit n? ?-connections k?
+    # Returns a dict with records, affected, errors (record numbers) and
+    # message for the first failure.
+    method load {table channel args} {
+        return [::ifx::_native_load $conn_handle $table $channel {*}$args]
+    }
+    
     # Get/set configuration (TDBC compatible)
     method configure {args} {
         if {[llength $args] == 0} {
@@ -508,6 +622,18 @@ oo::class create ::ifx::odbc::connection {
         } else {
             foreach {opt val} $args {
                 if {[dict exists $options $opt]} {
+                    if {$opt in $::ifx::odbc::connection::connectOptions} {
+                        error "option \"$opt\" can only be set when connecting"
+                    }
+                    if {$opt in $::ifx::odbc::connection::nativeOptions} {
+                        ::ifx::_native_configure $conn_handle $opt $val
+                    }
+                    if {$opt eq "-stmtcache"} {
+                        if {![string is entier -strict $val] || $val < 0} {
+                            error "-stmtcache must be a non-negative integer"
+                        }
+                        my TrimCache $val
+                    }
                     dict set options $opt $val
                 } else {
                     error "unknown option \"$opt\""
@@ -528,33 +654,30 @@ namespace eval ::ifx::odbc::statement {
     variable debugEnabled 0
 }
 
-# Static helper: Substitute named parameters (:name) in SQL
-proc ::ifx::odbc::statement::SubstituteNamedParams {sql params} {
-    # Sort parameter names by length (longest first) to avoid partial matches
-    # e.g., :bind should not match before :bind_tabid
-    set names [lsort -decreasing -command {apply {{a b} {
-        expr {[string length $a] - [string length $b]}
-    }}} [dict keys $params]]
-    
-    foreach name $names {
-        set value [dict get $params $name]
-        set escaped [::ifx::odbc::connection::EscapeString $value]
-        # Use lookahead to match :name followed by non-word char or end of string
-        regsub -all ":${name}(?=\[^a-zA-Z0-9_\]|$)" $sql "'$escaped'" sql
-    }
-    return $sql
-}
-
-# Static helper: Substitute positional parameters (?) in SQL
-proc ::ifx::odbc::statement::SubstitutePositionalParams {sql params} {
-    foreach value $params {
-        set idx [string first "?" $sql]
-        if {$idx >= 0} {
-            set escaped [::ifx::odbc::connection::EscapeString $value]
-            set sql "[string range $sql 0 [expr {$idx-1}]]'$escaped'[string range $sql [expr {$idx+1}] end]"
+# Static helper: Rewrite named parameters (:name) as ? markers for the
+# native prepare. Returns a list {nativeSql paramNames} where paramNames
+# holds one name per marker, in order. Quoted strings, dbname:table
+# references and :: casts are left untouched.
+proc ::ifx::odbc::statement::ParseParams {sql} {
+    set native ""
+    set names {}
+    set pos 0
+    set re {'[^']*'|"[^"]*"|\w:+|::+|:([a-zA-Z_][a-zA-Z0-9_]*)}
+    
+    while {[regexp -start $pos -indices -- $re $sql match name]} {
+        lassign $match from to
+        append native [string range $sql $pos [expr {$from - 1}]]
+        if {[lindex $name 0] >= 0} {
+            lappend names [string range $sql {*}$name]
+            append native "?"
+        } else {
+            append native [string range $sql $from $to]
         }
+        set pos [expr {$to + 1}]
     }
-    return $sql
+    append native [string range $sql $pos end]
+    
+    return [list $native $names]
 }
 
 # Static helper: Check if debug mode is enabled
@@ -569,6 +692,8 @@ oo::class create ::ifx::odbc::statement {
     variable connection
     variable conn_handle
     variable sql_template
+    variable stmt_handle
+    variable param_names
     variable param_types
     variable resultsets
     variable closed
@@ -577,9 +702,17 @@ oo::class create ::ifx::odbc::statement {
         set connection $connObj
         set conn_handle $connHandle
         set sql_template $sql
+        set stmt_handle ""
         set param_types {}
         set resultsets {}
         set closed 0
+        
+        # Prepare once on the server; execute only binds and runs it
+        lassign [::ifx::odbc::statement::ParseParams $sql] native_sql param_names
+        if {[catch {::ifx::_native_prepare $conn_handle $native_sql} handle]} {
+            error "SQL prepare failed: $handle\nSQL: [string range $sql 0 500]"
+        }
+        set stmt_handle $handle
     }
     
     destructor {
@@ -587,6 +720,11 @@ oo::class create ::ifx::odbc::statement {
         foreach rs $resultsets {
             catch {$rs close}
         }
+        
+        # Release the prepared statement
+        if {$stmt_handle ne ""} {
+            catch {::ifx::_native_close_statement $stmt_handle}
+        }
     }
     
     # Close statement (TDBC compatible)
@@ -599,14 +737,43 @@ oo::class create ::ifx::odbc::statement {
         return $connection
     }
     
+    # Cancel an execute in progress (see ifx::cancel). Mostly useful with
+    # execute -async; a blocked thread is cancelled from another thread
+    # with ::ifx::cancel [$stmt getDBhandle].
+    method cancel {} {
+        return [::ifx::cancel $stmt_handle]
+    }
+    
+    # Round trip accounting of all executes so far (see ifx::stats)
+    method stats {} {
+        return [::ifx::stats $stmt_handle]
+    }
+    
+    # Return native handle (for advanced usage)
+    method getDBhandle {} {
+        return $stmt_handle
+    }
+    
     # Execute with optional parameter dict (TDBC compatible)
-    # If params not provided, looks up :varname from caller's scope
+    # If params not provided, looks up :varname from caller's scope.
+    # -channels {name channel ...} streams those parameters from channels
+    # (read to end of file) instead of taking a value; for ? markers the
+    # name is the 0-based position.
     method execute {args} {
         if {$closed} {
             error "statement has been closed"
         }
         
-        set sql $sql_template
+        set channels {}
+        set callback ""
+        while {[llength $args] > 1} {
+            switch -- [lindex $args 0] {
+                -channels { set channels [lindex $args 1] }
+                -async    { set callback [lindex $args 1] }
+                default   { break }
+            }
+            set args [lrange $args 2 end]
+        }
         
         # Get explicit params if provided
         set params {}
@@ -614,65 +781,136 @@ oo::class create ::ifx::odbc::statement {
             set params [lindex $args 0]
         }
         
-        # Handle named parameters :name
-        if {[string first ":" $sql] >= 0} {
-            # Find all :name parameters in SQL
-            set pattern {:([a-zA-Z_][a-zA-Z0-9_]*)}
-            set matches {}
-            set tmpSql $sql
-            while {[regexp $pattern $tmpSql -> name]} {
-                lappend matches $name
-                regsub $pattern $tmpSql "" tmpSql
+        # Native -channels take parameter positions
+        set chan_args {}
+        if {[llength $param_names] > 0} {
+            set i 0
+            foreach name $param_names {
+                if {[dict exists $channels $name]} {
+                    lappend chan_args $i [dict get $channels $name]
+                    dict set params $name ""
+                }
+                incr i
             }
-            
-            # Build complete params dict - lookup from caller's scope if not provided
-            set fullParams {}
-            foreach name [lsort -unique $matches] {
+        } else {
+            set chan_args $channels
+        }
+        
+        if {[llength $param_names] > 0} {
+            # Named parameters :name - one value per ? marker, in order.
+            # Lookup from caller's scope if not provided
+            set found {}
+            set values {}
+            foreach name $param_names {
                 if {[dict exists $params $name]} {
-                    dict set fullParams $name [dict get $params $name]
+                    lappend values [dict get $params $name]
+                } elseif {[dict exists $found $name]} {
+                    lappend values [dict get $found $name]
                 } else {
                     # Try to get from caller's scope (2 levels up: execute -> foreach/allrows -> user code)
                     # or 1 level up for direct execute calls
-                    set found 0
+                    set ok 0
                     for {set level 1} {$level <= 3} {incr level} {
                         if {[catch {uplevel $level [list set $name]} value] == 0} {
-                            dict set fullParams $name $value
-                            set found 1
+                            dict set found $name $value
+                            lappend values $value
+                            set ok 1
                             break
                         }
                     }
-                    if {!$found} {
+                    if {!$ok} {
                         error "No value supplied for parameter \"$name\""
                     }
                 }
             }
-            
-            # Substitute all parameters
-            if {[dict size $fullParams] > 0} {
-                set sql [::ifx::odbc::statement::SubstituteNamedParams $sql $fullParams]
-            }
-        } elseif {[string first "?" $sql] >= 0 && [llength $params] > 0} {
+        } else {
             # Positional parameters ?
-            set sql [::ifx::odbc::statement::SubstitutePositionalParams $sql $params]
+            set values $params
         }
         
         # Debug output
         if {[::ifx::odbc::statement::IsDebugEnabled]} {
-            puts stderr "Executing SQL: $sql"
+            puts stderr "Executing SQL: $sql_template"
+            puts stderr "Parameters: $values"
+        }
+        
+        # Bind and execute the prepared statement
+        if {[llength $chan_args] > 0} {
+            set native_args [list -channels $chan_args $values]
+        } else {
+            set native_args [list $values]
+        }
+        
+        # -async: run in the background, AsyncDone gets the outcome
+        if {$callback ne ""} {
+            ::ifx::_native_execute_prepared $stmt_handle \
+                -async [namespace code [list my AsyncDone $callback]] {*}$native_args
+            return
         }
         
-        # Execute the SQL
-        if {[catch {set rs_handle [::ifx::_native_execute $conn_handle $sql]} err]} {
+        if {[catch {set rs_handle [::ifx::_native_execute_prepared $stmt_handle {*}$native_args]} err]} {
             # Re-throw with more context
-            error "SQL execution failed: $err\nSQL: [string range $sql 0 500]"
+            error "SQL execution failed: $err\nSQL: [string range $sql_template 0 500]"
         }
         
         set rs [::ifx::odbc::resultset new [self] $rs_handle]
+        set resultsets [::ifx::odbc::connection::LiveObjects $resultsets]
         lappend resultsets $rs
         
         return $rs
     }
     
+    # Completion of an execute -async: calls callback with "ok resultset"
+    # or "error message" from the event loop
+    method AsyncDone {callback status value} {
+        if {$status eq "ok"} {
+            set value [::ifx::odbc::resultset new [self] $value]
+            set resultsets [::ifx::odbc::connection::LiveObjects $resultsets]
+            lappend resultsets $value
+        } else {
+            set value "SQL execution failed: $value\nSQL: [string range $sql_template 0 500]"
+        }
+        uplevel #0 [list {*}$callback $status $value]
+    }
+    
+    # Execute once per parameter set, sending them to the server in
+    # batches of parameter arrays (see ifx::execute_many). paramSets holds
+    # one dict per row for :name parameters, or one list per row for ?
+    # markers. Returns a dict with affected, errors and unused (row indexes
+    # into paramSets) and message for the first failure; a batch failing
+    # as a whole ends it with the later rows in unused.
+    method executemany {paramSets args} {
+        if {$closed} {
+            error "statement has been closed"
+        }
+        
+        if {[llength $param_names] > 0} {
+            set rows {}
+            foreach params $paramSets {
+                set values {}
+                foreach name $param_names {
+                    if {![dict exists $params $name]} {
+                        error "No value supplied for parameter \"$name\" in row [llength $rows]"
+                    }
+                    lappend values [dict get $params $name]
+                }
+                lappend rows $values
+            }
+        } else {
+            set rows $paramSets
+        }
+        
+        if {[::ifx::odbc::statement::IsDebugEnabled]} {
+            puts stderr "Executing SQL: $sql_template"
+            puts stderr "Parameter sets: [llength $rows]"
+        }
+        
+        if {[catch {::ifx::_native_execute_many $stmt_handle $rows {*}$args} result]} {
+            error "SQL execution failed: $result\nSQL: [string range $sql_template 0 500]"
+        }
+        return $result
+    }
+    
     # Execute and return all rows (TDBC compatible)
     method allrows {args} {
         # Parse -as option and params
@@ -704,20 +942,7 @@ oo::class create ::ifx::odbc::statement {
         
         set rs [my execute $params]
         
-        set result {}
-        if {$as eq "lists"} {
-            while {1} {
-                set row [$rs nextlist]
-                if {$row eq ""} break
-                lappend result $row
-            }
-        } else {
-            while {1} {
-                set row [$rs nextdict]
-                if {$row eq ""} break
-                lappend result $row
-            }
-        }
+        set result [$rs allrows -as $as]
         
         $rs close
         
@@ -726,9 +951,10 @@ oo::class create ::ifx::odbc::statement {
     
     # Foreach with statement (TDBC compatible)
     method foreach {args} {
-        # Parse: ?-as dicts|lists? ?-columnsvariable varName? ?--? varName ?params? script
+        # Parse: ?-as dicts|lists? ?-columnsvariable varName? ?-chunk n? ?--? varName ?params? script
         set as "dicts"
         set columnsVar ""
+        set chunk ""
         
         set i 0
         while {$i < [llength $args]} {
@@ -742,6 +968,10 @@ oo::class create ::ifx::odbc::statement {
                     incr i
                     set columnsVar [lindex $args $i]
                 }
+                -chunk {
+                    incr i
+                    set chunk [lindex $args $i]
+                }
                 -- {
                     incr i
                     break
@@ -767,46 +997,40 @@ oo::class create ::ifx::odbc::statement {
             error "wrong # args: should be \"foreach ?options? varName ?params? script\""
         }
         
-        upvar 1 $varName row
-        if {$columnsVar ne ""} {
-            upvar 1 $columnsVar columns
-        }
-        
         set rs [my execute $params]
         
+        set options [list -as $as]
         if {$columnsVar ne ""} {
-            set columns [$rs columns]
+            lappend options -columnsvariable $columnsVar
         }
-        
-        set result ""
-        while {1} {
-            if {$as eq "lists"} {
-                set row [$rs nextlist]
-            } else {
-                set row [$rs nextdict]
-            }
-            
-            if {$row eq ""} break
-            
-            set code [catch {uplevel 1 $script} result opts]
-            switch $code {
-                0 { }
-                1 { 
-                    $rs close
-                    return -options $opts $result 
-                }
-                2 { 
-                    $rs close
-                    return -options $opts $result 
-                }
-                3 { break }
-                4 { continue }
-            }
+        if {$chunk ne ""} {
+            lappend options -chunk $chunk
         }
         
+        # The resultset runs the loop in our caller's scope
+        set code [catch {uplevel 1 [list $rs foreach {*}$options -- $varName $script]} \
+                      result opts]
+        
         $rs close
         
-        return $result
+        # A return in the script leaves our caller, not just this method
+        if {$code == 2} {
+            dict incr opts -level
+        }
+        return -options $opts $result
+    }
+    
+    # Get/set native options of this statement (-rowsetsize, -typed, -datetime).
+    # Defaults come from the connection at prepare time; changes apply to
+    # result sets of later executes.
+    method configure {args} {
+        if {[llength $args] == 0} {
+            return [::ifx::_native_configure $stmt_handle]
+        } elseif {[llength $args] == 1} {
+            return [::ifx::_native_configure $stmt_handle [lindex $args 0]]
+        }
+        ::ifx::_native_configure $stmt_handle {*}$args
+        return
     }
     
     # Get parameter information (TDBC compatible)
@@ -864,15 +1088,26 @@ oo::class create ::ifx::odbc::resultset {
     variable statement
     variable rs_handle
     variable column_names
-    variable columns_fetched
+    variable column_info
     variable row_count
+    variable row_buffer
+    variable buffer_as
+    variable buffer_pos
     
     constructor {stmtObj rsHandle} {
         set statement $stmtObj
         set rs_handle $rsHandle
-        set columns_fetched 0
-        set column_names {}
         set row_count 0
+        set row_buffer {}
+        set buffer_as dicts
+        set buffer_pos 0
+        
+        # Column metadata is described at execute time; read it once here
+        set column_info [::ifx::_native_columns $rs_handle]
+        set column_names {}
+        foreach info $column_info {
+            lappend column_names [dict get $info name]
+        }
     }
     
     destructor {
@@ -889,19 +1124,60 @@ oo::class create ::ifx::odbc::resultset {
         return $statement
     }
     
+    # Cancel a fetch in progress (see ifx::cancel)
+    method cancel {} {
+        return [::ifx::cancel $rs_handle]
+    }
+    
+    # Round trip accounting of this result set (see ifx::stats)
+    method stats {} {
+        return [::ifx::stats $rs_handle]
+    }
+    
+    # Refill the row buffer with the next rowset (one native call per
+    # rowset instead of one per row), built natively as dicts or lists.
+    # Returns the number of buffered rows.
+    method FillBuffer {as} {
+        set row_buffer [::ifx::_native_fetchmany $rs_handle 0 -as $as]
+        set buffer_as $as
+        set buffer_pos 0
+        return [llength $row_buffer]
+    }
+    
+    # Next buffered row as a dict or list; "" at the end of the data.
+    # Only a row buffered in the other shape is converted here.
+    method NextRow {as} {
+        if {$buffer_pos >= [llength $row_buffer] && [my FillBuffer $as] == 0} {
+            return ""
+        }
+        
+        set row [lindex $row_buffer $buffer_pos]
+        incr buffer_pos
+        incr row_count
+        
+        if {$as eq $buffer_as} {
+            return $row
+        } elseif {$as eq "lists"} {
+            return [dict values $row]
+        }
+        set row_dict {}
+        foreach name $column_names value $row {
+            dict set row_dict $name $value
+        }
+        return $row_dict
+    }
+    
     # Get column names (TDBC compatible)
     method columns {} {
-        if {!$columns_fetched} {
-            # Peek at first row to get column names
-            set row_dict [::ifx::_native_fetch $rs_handle]
-            if {$row_dict ne ""} {
-                set column_names [dict keys $row_dict]
-                set columns_fetched 1
-            }
-        }
         return $column_names
     }
     
+    # Column metadata: list of dicts with name, type, precision, scale
+    # and nullable
+    method columninfo {} {
+        return $column_info
+    }
+    
     # Fetch next row into variable (TDBC compatible)
     # Returns 1 if row fetched, 0 if no more rows
     method nextrow {args} {
@@ -935,78 +1211,253 @@ oo::class create ::ifx::odbc::resultset {
         
         upvar 1 $varName row
         
-        set row_dict [::ifx::_native_fetch $rs_handle]
+        set next [my NextRow $as]
         
-        if {$row_dict eq ""} {
+        if {$next eq ""} {
             return 0
         }
         
-        incr row_count
-        
-        if {!$columns_fetched} {
-            set column_names [dict keys $row_dict]
-            set columns_fetched 1
-        }
-        
-        if {$as eq "lists"} {
-            set row {}
-            foreach col $column_names {
-                if {[dict exists $row_dict $col]} {
-                    lappend row [dict get $row_dict $col]
-                } else {
-                    lappend row ""
-                }
-            }
-        } else {
-            set row $row_dict
-        }
-        
+        set row $next
         return 1
     }
     
     # Fetch next row as list (TDBC compatible)
     method nextlist {} {
-        set row_dict [::ifx::_native_fetch $rs_handle]
-        
-        if {$row_dict eq ""} {
-            return ""
+        return [my NextRow lists]
+    }
+    
+    # Fetch next row as dict (TDBC compatible)
+    method nextdict {} {
+        return [my NextRow dicts]
+    }
+    
+    # Fetch the next row as a dict, writing column to channel in chunks
+    # instead of into the row (see ifx::fetchblob). Returns "" at the end.
+    method fetchblob {column channel} {
+        if {$buffer_pos < [llength $row_buffer]} {
+            error "fetchblob can't be mixed with rows already read by nextrow/nextdict/nextlist"
+        }
+        set row [::ifx::_native_fetchblob $rs_handle $column $channel]
+        if {$row ne ""} {
+            incr row_count
+        }
+        return $row
+    }
+    
+    # Fetch all remaining rows (TDBC compatible)
+    method allrows {args} {
+        set as "dicts"
+        foreach {opt val} $args {
+            switch -- $opt {
+                -as { set as $val }
+                default { error "unknown option \"$opt\": must be -as" }
+            }
         }
         
-        incr row_count
-        
-        if {!$columns_fetched} {
-            set column_names [dict keys $row_dict]
-            set columns_fetched 1
+        # Rows already buffered by nextdict/nextlist come first
+        set result {}
+        while {$buffer_pos < [llength $row_buffer]} {
+            lappend result [my NextRow $as]
         }
+        set row_buffer {}
+        set buffer_pos 0
+        
+        # Then everything else in one native call
+        set rest [::ifx::_native_allrows $rs_handle -as $as]
+        incr row_count [llength $rest]
+        if {[llength $result] == 0} {
+            return $rest
+        }
+        return [concat $result $rest]
+    }
+    
+    # Fetch all remaining rows by column: a dict of column name -> list
+    # of values, filled natively from the rowset buffers
+    method allcolumns {} {
+        # Rows already buffered by nextdict/nextlist come first
+        if {$buffer_pos < [llength $row_buffer]} {
+            set buffered [dict create]
+            foreach name $column_names {
+                dict set buffered $name {}
+            }
+            while {$buffer_pos < [llength $row_buffer]} {
+                foreach name $column_names value [my NextRow lists] {
+                    dict lappend buffered $name $value
+                }
+            }
+        }
+        set row_buffer {}
+        set buffer_pos 0
         
-        set row {}
-        foreach col $column_names {
-            if {[dict exists $row_dict $col]} {
-                lappend row [dict get $row_dict $col]
+        set result [::ifx::_native_fetchcolumns $rs_handle]
+        if {[dict size $result] > 0} {
+            incr row_count [llength [lindex $result 1]]
+        }
+        if {[info exists buffered]} {
+            dict for {name values} $result {
+                dict set result $name [list {*}[dict get $buffered $name] {*}$values]
+            }
+        }
+        return $result
+    }
+    
+    # Write all remaining rows to channel, formatted natively (see
+    # ifx::export), and return how many there were
+    # export channel ?-format csv|tsv|unload|jsonl? ?-delimiter c?
+    #     ?-null str? ?-compress gzip|deflate|compress?
+    #
+    # -compress pushes a zlib transform on the channel for the export
+    # and pops it again at the end, which finishes the compressed stream.
+    method export {channel args} {
+        if {$buffer_pos < [llength $row_buffer]} {
+            error "export can't be mixed with rows already read by nextrow/nextdict/nextlist"
+        }
+        set compress ""
+        set native {}
+        foreach {opt val} $args {
+            if {$opt eq "-compress"} {
+                set compress $val
             } else {
-                lappend row ""
+                lappend native $opt $val
             }
         }
+        if {[llength $args] % 2} {
+            error "missing value for option \"[lindex $args end]\""
+        }
         
-        return $row
+        if {$compress ne ""} {
+            zlib push $compress $channel
+        }
+        try {
+            set n [::ifx::_native_export $rs_handle $channel {*}$native]
+        } finally {
+            if {$compress ne ""} {
+                chan pop $channel
+            }
+        }
+        incr row_count $n
+        return $n
     }
     
-    # Fetch next row as dict (TDBC compatible)
-    method nextdict {} {
-        set row_dict [::ifx::_native_fetch $rs_handle]
+    # Run script for each remaining row (TDBC compatible)
+    # foreach ?-as dicts|lists? ?-columnsvariable varName? ?-chunk n? ?--? varName script
+    #
+    # -chunk n lets the event loop run after every n rows: a coroutine
+    # yields and is resumed from the event loop, other callers wait in
+    # vwait for a timer event. Other requests are then served during long
+    # scans, with the usual care needed around reentrant event handling.
+    method foreach {args} {
+        set as "dicts"
+        set columnsVar ""
+        set chunk ""
         
-        if {$row_dict eq ""} {
-            return ""
+        set i 0
+        while {$i < [llength $args]} {
+            set arg [lindex $args $i]
+            switch -glob -- $arg {
+                -as {
+                    incr i
+                    set as [lindex $args $i]
+                }
+                -columnsvariable {
+                    incr i
+                    set columnsVar [lindex $args $i]
+                }
+                -chunk {
+                    incr i
+                    set chunk [lindex $args $i]
+                }
+                -- {
+                    incr i
+                    break
+                }
+                -* {
+                    error "unknown option \"$arg\""
+                }
+                default {
+                    break
+                }
+            }
+            incr i
         }
         
-        incr row_count
+        set remaining [lrange $args $i end]
+        if {[llength $remaining] != 2} {
+            error "wrong # args: should be \"foreach ?options? varName script\""
+        }
+        lassign $remaining varName script
         
-        if {!$columns_fetched} {
-            set column_names [dict keys $row_dict]
-            set columns_fetched 1
+        if {$chunk ne "" && (![string is integer -strict $chunk] || $chunk <= 0)} {
+            error "-chunk must be a positive integer"
         }
         
-        return $row_dict
+        if {$columnsVar ne ""} {
+            upvar 1 $columnsVar columns
+            set columns $column_names
+        }
+        
+        # Rows already buffered by nextdict/nextlist come first
+        if {$buffer_pos < [llength $row_buffer]} {
+            upvar 1 $varName row
+            while {$buffer_pos < [llength $row_buffer]} {
+                set row [my NextRow $as]
+                set code [catch {uplevel 1 $script} result opts]
+                switch $code {
+                    0 { }
+                    2 {
+                        dict incr opts -level
+                        return -options $opts $result
+                    }
+                    3 { return }
+                    4 { continue }
+                    default { return -options $opts $result }
+                }
+            }
+        }
+        set row_buffer {}
+        set buffer_pos 0
+        
+        # The rest is fetched and looped over natively; a return in the
+        # script comes back from it as a return to pass on to our caller
+        if {$chunk eq ""} {
+            set limit {}
+        } else {
+            set limit [list -limit $chunk]
+        }
+        while {1} {
+            set code [catch {uplevel 1 [list ::ifx::_native_foreach $rs_handle -as $as \
+                                            {*}$limit $varName $script]} n opts]
+            if {$code == 2} {
+                dict incr opts -level
+            }
+            if {$code != 0} {
+                return -options $opts $n
+            }
+            if {$chunk eq ""} {
+                incr row_count $n
+                return
+            }
+            if {$n < 0} {
+                return
+            }
+            incr row_count $n
+            if {$n < $chunk} {
+                return
+            }
+            my WaitEvents
+        }
+    }
+    
+    # Let the event loop run once between two chunks of foreach -chunk
+    method WaitEvents {} {
+        if {[info coroutine] ne ""} {
+            after 0 [list [info coroutine]]
+            yield
+        } else {
+            set wait [namespace current]::chunk_wait
+            after 0 [list set $wait 1]
+            vwait $wait
+        }
     }
     
     # Get row count (TDBC compatible)
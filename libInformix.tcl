@@ -66,12 +66,10 @@ oo::class create ::ifx::Connection {
 oo::class create ::ifx::ResultSet {
     variable result_handle
     variable column_names
-    variable columns_fetched
 
     constructor {handle} {
         set result_handle $handle
-        set columns_fetched 0
-        set column_names {}
+        my FetchColumnNames
     }
 
     destructor {
@@ -80,36 +78,12 @@ oo::class create ::ifx::ResultSet {
 
     # Get column headers (list of column names)
     method headers {} {
-        if {!$columns_fetched} {
-            my FetchColumnNames
-        }
         return $column_names
     }
 
-    # Fetch next row as list
+    # Fetch next row as list (values in header order)
     method next {} {
-        set row_dict [::ifx::fetch $result_handle]
-        
-        if {$row_dict eq ""} {
-            return {}
-        }
-        
-        # Ensure we have column names
-        if {!$columns_fetched} {
-            my FetchColumnNames $row_dict
-        }
-        
-        # Convert dict to list in column order
-        set row_list {}
-        foreach col $column_names {
-            if {[dict exists $row_dict $col]} {
-                lappend row_list [dict get $row_dict $col]
-            } else {
-                lappend row_list ""
-            }
-        }
-        
-        return $row_list
+        return [::ifx::fetchlist $result_handle]
     }
 
     # Fetch all rows as list of lists
@@ -149,17 +123,13 @@ oo::class create ::ifx::ResultSet {
         ::ifx::close_result $result_handle
     }
 
-    # Private method to fetch column names from first row
-    method FetchColumnNames {{first_row_dict ""}} {
-        if {$first_row_dict ne ""} {
-            # Extract from first row dict
-            set column_names [dict keys $first_row_dict]
-        } else {
-            # Fetch a row to get column names, then we need to re-execute
-            # For now, just mark as fetched
-            set column_names {}
+    # Private method to read the column names from the result description
+    # (no row is consumed)
+    method FetchColumnNames {} {
+        set column_names {}
+        foreach info [::ifx::columns $result_handle] {
+            lappend column_names [dict get $info name]
         }
-        set columns_fetched 1
     }
 }
 
@@ -13,8 +13,10 @@ load libifxcli.so Ifxcli
 rename ::ifx::connect ::ifx::_native_connect
 rename ::ifx::execute ::ifx::_native_execute
 rename ::ifx::fetch ::ifx::_native_fetch
+rename ::ifx::fetchlist ::ifx::_native_fetchlist
 rename ::ifx::close_result ::ifx::_native_close_result
 rename ::ifx::disconnect ::ifx::_native_disconnect
+rename ::ifx::columns ::ifx::_native_columns
 
 namespace eval ::ifx {
     # Export the connect command
@@ -73,12 +75,10 @@ oo::class create ::ifx::Connection {
 oo::class create ::ifx::ResultSet {
     variable result_handle
     variable column_names
-    variable columns_fetched
     
     constructor {handle} {
         set result_handle $handle
-        set columns_fetched 0
-        set column_names {}
+        my FetchColumnNames
     }
     
     destructor {
@@ -87,45 +87,12 @@ oo::class create ::ifx::ResultSet {
     
     # Get column headers (list of column names)
     method headers {} {
-        if {!$columns_fetched} {
-            # Need to peek at first row to get column names
-            # We'll fetch and cache it
-            set row_dict [::ifx::_native_fetch $result_handle]
-            if {$row_dict ne ""} {
-                set column_names [dict keys $row_dict]
-                set columns_fetched 1
-                # Note: This consumes the first row, which is a limitation
-                # Ideally we'd use SQLDescribeCol from the C extension
-            }
-        }
         return $column_names
     }
     
-    # Fetch next row as list
+    # Fetch next row as list (values in header order)
     method next {} {
-        set row_dict [::ifx::_native_fetch $result_handle]
-        
-        if {$row_dict eq ""} {
-            return {}
-        }
-        
-        # Ensure we have column names from the first row
-        if {!$columns_fetched} {
-            set column_names [dict keys $row_dict]
-            set columns_fetched 1
-        }
-        
-        # Convert dict to list in column order
-        set row_list {}
-        foreach col $column_names {
-            if {[dict exists $row_dict $col]} {
-                lappend row_list [dict get $row_dict $col]
-            } else {
-                lappend row_list ""
-            }
-        }
-        
-        return $row_list
+        return [::ifx::_native_fetchlist $result_handle]
     }
     
     # Fetch all rows as list of lists
@@ -165,17 +132,13 @@ oo::class create ::ifx::ResultSet {
         ::ifx::_native_close_result $result_handle
     }
     
-    # Private method to fetch column names from first row
-    method FetchColumnNames {{first_row_dict ""}} {
-        if {$first_row_dict ne ""} {
-            # Extract from first row dict
-            set column_names [dict keys $first_row_dict]
-        } else {
-            # Fetch a row to get column names, then we need to re-execute
-            # For now, just mark as fetched
-            set column_names {}
+    # Private method to read the column names from the result description
+    # (no row is consumed)
+    method FetchColumnNames {} {
+        set column_names {}
+        foreach info [::ifx::_native_columns $result_handle] {
+            lappend column_names [dict get $info name]
         }
-        set columns_fetched 1
     }
 }
 
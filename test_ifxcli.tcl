@@ -35,6 +35,9 @@ puts "\nTesting query execution..."
 if {[catch {
     set result [::ifx::execute $conn "SELECT FIRST 5 tabname FROM systables"]
     puts "Query executed: $result"
+    foreach col [::ifx::columns $result] {
+        puts "  Column: $col"
+    }
 } err]} {
     puts stderr "Query failed: $err"
     ::ifx::disconnect $conn
@@ -69,6 +72,15 @@ while {1} {
 
 puts "\nTotal rows fetched: $row_count"
 
+::ifx::close_result $result
+
+# Fetch rows as lists (values in ::ifx::columns order)
+puts "\nFetching rows as lists..."
+set result [::ifx::execute $conn "SELECT FIRST 3 tabid, tabname FROM systables"]
+while {[set row [::ifx::fetchlist $result]] ne ""} {
+    puts "Row: $row"
+}
+
 # Cleanup
 ::ifx::close_result $result
 ::ifx::disconnect $conn
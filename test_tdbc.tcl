@@ -183,6 +183,636 @@ if {[catch {
     puts stderr "Test 12 failed: $err"
 }
 
+# Test prepared statement re-execution with bound parameters
+puts "\n=== Test 13: prepared statement with bound parameters ==="
+if {[catch {
+    set stmt [db prepare "SELECT tabname FROM systables WHERE tabid = :tabid"]
+    foreach tabid {1 2 3} {
+        set rows [$stmt allrows -as lists]
+        puts "  tabid $tabid: $rows"
+    }
+    $stmt close
+    
+    set stmt [db prepare "SELECT tabid FROM systables WHERE tabname = :name"]
+    puts "  Quote in value: [$stmt allrows [dict create name "x' OR '1'='1"]]"
+    $stmt close
+} err]} {
+    puts stderr "Test 13 failed: $err"
+}
+
+# Test block fetch across rowset boundaries
+puts "\n=== Test 14: block fetch with small -rowsetsize ==="
+if {[catch {
+    db configure -rowsetsize 2
+    set stmt [db prepare "SELECT FIRST 5 tabname, tabid FROM systables"]
+    set rs [$stmt execute]
+    puts "  First row: [$rs nextlist]"
+    puts "  Remaining: [$rs allrows -as lists]"
+    puts "  Row count: [$rs rowcount]"
+    $rs close
+    $stmt close
+    db configure -rowsetsize 256
+} err]} {
+    puts stderr "Test 14 failed: $err"
+}
+
+# Test typed numeric columns
+puts "\n=== Test 15: -typed numeric columns ==="
+if {[catch {
+    set stmt [db prepare "SELECT FIRST 1 tabid, nrows, tabname FROM systables"]
+    $stmt configure -typed 1
+    set row [lindex [$stmt allrows] 0]
+    puts "  Row: $row"
+    puts "  tabid + 1 = [expr {[dict get $row tabid] + 1}]"
+    puts "  Statement options: [$stmt configure]"
+    $stmt close
+} err]} {
+    puts stderr "Test 15 failed: $err"
+}
+
+# Test native date conversion
+puts "\n=== Test 16: -datetime modes ==="
+if {[catch {
+    set stmt [db prepare "SELECT FIRST 1 TODAY AS d, CURRENT AS ts FROM systables"]
+    foreach mode {text iso seconds} {
+        $stmt configure -datetime $mode
+        puts "  $mode: [lindex [$stmt allrows -as lists] 0]"
+    }
+    set ts [lindex [$stmt allrows -as lists] 0 1]
+    puts "  clock format: [clock format $ts]"
+    $stmt close
+} err]} {
+    puts stderr "Test 16 failed: $err"
+}
+
+# Run a statement that returns no rows, such as DDL
+proc run_sql {sql} {
+    set stmt [db prepare $sql]
+    $stmt execute
+    $stmt close
+}
+
+# Scratch table for the long value tests (a temp table lives in this session)
+run_sql "CREATE TEMP TABLE tdbc_blob (id INTEGER, body TEXT, data BYTE) WITH NO LOG"
+
+# Test streaming a long column to a channel
+puts "\n=== Test 17: fetchblob ==="
+if {[catch {
+    set body [string repeat "0123456789abcdef" 8192]
+    set stmt [db prepare "INSERT INTO tdbc_blob (id, body) VALUES (1, :body)"]
+    $stmt execute
+    $stmt close
+    
+    set f [file tempfile path]
+    set stmt [db prepare "SELECT id, body FROM tdbc_blob WHERE id = 1"]
+    set rs [$stmt execute]
+    set row [$rs fetchblob body $f]
+    set end [$rs fetchblob body $f]
+    $rs close
+    $stmt close
+    close $f
+    puts "  Row: $row, [file size $path] bytes in the file"
+    if {[dict get $row body] != [string length $body] ||
+            [file size $path] != [string length $body] || $end ne ""} {
+        error "expected [string length $body] bytes written and one row"
+    }
+    file delete $path
+} err]} {
+    puts stderr "Test 17 failed: $err"
+}
+
+# Test streaming parameters from a channel and from a long value
+puts "\n=== Test 18: execute -channels ==="
+if {[catch {
+    set data [binary format c* [lrepeat 30000 0 1 2 127 -128 -1 10]]
+    set f [file tempfile path]
+    fconfigure $f -translation binary
+    puts -nonewline $f $data
+    close $f
+    set body [string repeat x 100000]
+    
+    set f [open $path rb]
+    set stmt [db prepare "INSERT INTO tdbc_blob (id, body, data) VALUES (2, :body, :data)"]
+    $stmt execute -channels [list data $f]
+    $stmt close
+    close $f
+    file delete $path
+    
+    set stmt [db prepare "SELECT body, data FROM tdbc_blob WHERE id = 2"]
+    lassign [lindex [$stmt allrows -as lists] 0] body_read data_read
+    $stmt close
+    puts "  Read back [string length $body_read] + [string length $data_read] bytes"
+    if {$body_read ne $body || $data_read ne $data} {
+        error "values read back differ from those written"
+    }
+} err]} {
+    puts stderr "Test 18 failed: $err"
+}
+
+# Scratch table for the bulk tests
+run_sql "CREATE TEMP TABLE tdbc_test (id INTEGER NOT NULL, name VARCHAR(20)) WITH NO LOG"
+
+# Test bulk DML with parameter arrays
+puts "\n=== Test 19: executemany ==="
+if {[catch {
+    set stmt [db prepare "INSERT INTO tdbc_test (id, name) VALUES (:id, :name)"]
+    # Row 2 has no id: NULL into a NOT NULL column fails on its own
+    set status [$stmt executemany [list {id 1 name one} {id 2 name two} \
+        {id "" name bad} {id 4 name four}] -batch 2]
+    puts "  Status: $status"
+    # A driver that stops at the failing row leaves row 3 unused
+    if {[dict get $status errors] ne "2" ||
+            [dict get $status affected] + [llength [dict get $status unused]] != 3} {
+        error "expected row 2 in errors and the others inserted or unused"
+    }
+    $stmt close
+} err]} {
+    puts stderr "Test 19 failed: $err"
+}
+
+# Test native allrows against a row by row read
+puts "\n=== Test 20: allrows of a whole result ==="
+if {[catch {
+    set stmt [db prepare "SELECT tabid, tabname FROM systables WHERE tabid < 50 ORDER BY tabid"]
+    set dicts [$stmt allrows]
+    set lists [$stmt allrows -as lists]
+    set rs [$stmt execute]
+    set first [$rs nextlist]
+    set rest [$rs allrows -as lists]
+    $rs close
+    $stmt close
+    puts "  [llength $dicts] rows, first: [lindex $dicts 0]"
+    if {[llength $lists] != [llength $dicts] ||
+            [dict values [lindex $dicts end]] ne [lindex $lists end] ||
+            [list $first {*}$rest] ne $lists} {
+        error "dicts, lists and nextlist + allrows differ"
+    }
+} err]} {
+    puts stderr "Test 20 failed: $err"
+}
+
+# First tabid above n, returned from inside a foreach body
+proc first_tabid_over {n} {
+    db foreach -as lists row "SELECT tabid FROM systables ORDER BY tabid" {
+        if {[lindex $row 0] > $n} {
+            return [lindex $row 0]
+        }
+    }
+    return ""
+}
+
+# Test break, continue, return and errors in foreach bodies
+puts "\n=== Test 21: foreach break/continue/return ==="
+if {[catch {
+    set stmt [db prepare "SELECT tabid FROM systables WHERE tabid <= 10 ORDER BY tabid"]
+    set rs [$stmt execute]
+    set seen {}
+    $rs foreach -as lists row {
+        set id [lindex $row 0]
+        if {$id == 2} {
+            continue
+        }
+        if {$id == 4} {
+            break
+        }
+        lappend seen $id
+    }
+    $rs close
+    puts "  continue at 2, break at 4: $seen"
+    if {$seen ne "1 3"} {
+        error "expected rows 1 and 3"
+    }
+    
+    set id [first_tabid_over 5]
+    puts "  return from the body: $id"
+    if {$id != 6} {
+        error "expected 6 to be returned"
+    }
+    
+    set failed [catch {$stmt foreach row {error "body failed"}} msg]
+    puts "  error in the body: $msg"
+    if {!$failed || $msg ne "body failed"} {
+        error "expected the body's error"
+    }
+    # The statement is still usable after the loops ended early
+    set n [llength [$stmt allrows]]
+    $stmt close
+    if {$n != 10} {
+        error "expected 10 rows after the loops, got $n"
+    }
+} err]} {
+    puts stderr "Test 21 failed: $err"
+}
+
+# Test that closed native handles are refused, also through objects that
+# cached the handle before it was closed
+puts "\n=== Test 22: closed handles ==="
+if {[catch {
+    set h [::ifx::_native_execute [db getDBhandle] "SELECT FIRST 1 tabid FROM systables"]
+    ::ifx::_native_fetchlist $h
+    ::ifx::_native_close_result $h
+    foreach handle [list $h [format %s $h]] {
+        if {![catch {::ifx::_native_fetchlist $handle} msg]} {
+            error "fetch on the closed $handle succeeded"
+        }
+    }
+    puts "  Closed result: $msg"
+    
+    set stmt [db prepare "SELECT FIRST 1 tabid FROM systables"]
+    set sh [$stmt getDBhandle]
+    $stmt allrows
+    $stmt close
+    if {![catch {::ifx::_native_execute_prepared $sh {}} msg]} {
+        error "execute of the closed $sh succeeded"
+    }
+    puts "  Closed statement: $msg"
+} err]} {
+    puts stderr "Test 22 failed: $err"
+}
+
+# Test connection pooling
+puts "\n=== Test 23: -pool ==="
+if {[catch {
+    ::ifx::pool create tdbc_test_pool -maxidle 2
+    ::ifx::odbc::connection create pdb "DSN=eppixprod" -pool tdbc_test_pool
+    # An open BEGIN WORK is rolled back before the connection is pooled
+    pdb begintransaction
+    pdb close
+    ::ifx::odbc::connection create pdb "DSN=eppixprod" -pool tdbc_test_pool
+    pdb begintransaction
+    pdb rollback
+    pdb close
+    set stats [::ifx::pool stats tdbc_test_pool]
+    puts "  Stats: $stats"
+    if {[dict get $stats hits] != 1 || [dict get $stats idle] != 1} {
+        error "expected the second connection to reuse the pooled one"
+    }
+    ::ifx::pool destroy tdbc_test_pool
+} err]} {
+    puts stderr "Test 23 failed: $err"
+}
+
+# Test moving a native connection to another thread and back
+puts "\n=== Test 24: detach/attach ==="
+if {[catch {
+    if {[catch {package require Thread}]} {
+        puts "  Thread package not available, skipped"
+    } else {
+        set lib [lindex [lsearch -inline -index 1 [info loaded] Ifxcli] 0]
+        set conn [::ifx::_native_connect eppixprod]
+        
+        # Open result sets pin a connection to its thread
+        set h [::ifx::_native_execute $conn "SELECT FIRST 1 tabid FROM systables"]
+        if {![catch {::ifx::detach $conn} msg]} {
+            error "detached a connection with an open result set"
+        }
+        puts "  With a result set open: $msg"
+        ::ifx::_native_close_result $h
+        
+        ::ifx::detach $conn
+        set worker [thread::create thread::wait]
+        set rows [thread::send $worker [list apply {{lib conn} {
+            load $lib Ifxcli
+            ::ifx::attach $conn
+            set h [::ifx::execute $conn "SELECT FIRST 3 tabid FROM systables"]
+            set rows [::ifx::allrows $h -as lists]
+            ::ifx::close_result $h
+            ::ifx::detach $conn
+            return $rows
+        }} $lib $conn]]
+        thread::release $worker
+        puts "  Rows read in the worker: $rows"
+        
+        ::ifx::attach $conn
+        set h [::ifx::_native_execute $conn "SELECT FIRST 1 tabid FROM systables"]
+        ::ifx::_native_close_result $h
+        ::ifx::_native_disconnect $conn
+        if {[llength $rows] != 3} {
+            error "expected 3 rows from the worker"
+        }
+    }
+} err]} {
+    puts stderr "Test 24 failed: $err"
+}
+
+# Completion callback of execute -async
+proc async_done {status value} {
+    set ::async_result [list $status $value]
+}
+
+# Test execute -async and foreach -chunk with the event loop
+puts "\n=== Test 25: execute -async, foreach -chunk ==="
+if {[catch {
+    set stmt [db prepare "SELECT tabid FROM systables WHERE tabid <= 10 ORDER BY tabid"]
+    $stmt execute -async async_done
+    vwait ::async_result
+    lassign $::async_result status rs
+    if {$status ne "ok"} {
+        error $rs
+    }
+    
+    # The timer runs when the loop lets the event loop in after row 2
+    set ticks 0
+    after 0 {incr ticks}
+    set seen {}
+    $rs foreach -as lists -chunk 2 row {
+        lappend seen [lindex $row 0]
+        if {[llength $seen] == 3} {
+            break
+        }
+    }
+    $rs close
+    $stmt close
+    puts "  Rows: $seen, timer events: $ticks"
+    if {$seen ne "1 2 3" || $ticks != 1} {
+        error "expected rows 1 2 3 with the timer run in between"
+    }
+} err]} {
+    puts stderr "Test 25 failed: $err"
+}
+
+# Test -maxrows, -timeout and cancelling from another thread
+puts "\n=== Test 26: -maxrows, -timeout and cancel ==="
+if {[catch {
+    set stmt [db prepare "SELECT tabid FROM systables"]
+    $stmt configure -maxrows 3
+    set n [llength [$stmt allrows]]
+    $stmt close
+    puts "  -maxrows 3: $n rows"
+    if {$n != 3} {
+        error "expected 3 rows"
+    }
+    
+    # Runs for long enough to be stopped by the timeout and the watchdog
+    set slow "SELECT COUNT(*) FROM systables a, systables b, systables c, systables d"
+    set stmt [db prepare $slow]
+    $stmt configure -timeout 1000
+    set failed [catch {$stmt allrows} msg]
+    $stmt close
+    puts "  -timeout 1000: $msg"
+    if {!$failed} {
+        error "the query outlasted -timeout"
+    }
+    
+    if {[catch {package require Thread}]} {
+        puts "  Thread package not available, cancel skipped"
+    } else {
+        set lib [lindex [lsearch -inline -index 1 [info loaded] Ifxcli] 0]
+        set watchdog [thread::create thread::wait]
+        thread::send $watchdog [list load $lib Ifxcli]
+        
+        set stmt [db prepare $slow]
+        thread::send -async $watchdog [list after 500 [list ::ifx::cancel [$stmt getDBhandle]]]
+        set failed [catch {$stmt allrows} msg]
+        $stmt close
+        puts "  Cancelled statement: $msg"
+        if {!$failed} {
+            error "the statement was not cancelled"
+        }
+        
+        # A direct execute is cancelled through its connection
+        set conn [db getDBhandle]
+        thread::send -async $watchdog [list after 500 [list ::ifx::cancel $conn]]
+        if {![catch {::ifx::_native_execute $conn $slow} msg]} {
+            ::ifx::_native_close_result $msg
+            error "the direct execute was not cancelled"
+        }
+        puts "  Cancelled execute: $msg"
+        thread::release $watchdog
+    }
+} err]} {
+    puts stderr "Test 26 failed: $err"
+}
+
+# Test round trip accounting
+puts "\n=== Test 27: stats ==="
+if {[catch {
+    set stmt [db prepare "SELECT tabid FROM systables WHERE tabid <= 10"]
+    $stmt configure -rowsetsize 4
+    set rs [$stmt execute]
+    set rows [llength [$rs allrows]]
+    set rs_stats [$rs stats]
+    $rs close
+    $stmt allrows
+    set stmt_stats [$stmt stats]
+    $stmt close
+    puts "  Result set: $rs_stats"
+    puts "  Statement: $stmt_stats"
+    foreach key {executes fetches rows roundtrips fetchbuffer rowwidth rowset} {
+        if {![dict exists $rs_stats $key]} {
+            error "no $key in the result set stats"
+        }
+    }
+    if {[dict get $rs_stats rows] != $rows || [dict get $stmt_stats executes] != 2 ||
+            [dict get $stmt_stats rows] != 2 * $rows} {
+        error "expected $rows rows per execute and 2 executes"
+    }
+} err]} {
+    puts stderr "Test 27 failed: $err"
+}
+
+# Test columnar fetch against rows
+puts "\n=== Test 28: allcolumns ==="
+if {[catch {
+    set stmt [db prepare "SELECT tabid, tabname FROM systables WHERE tabid <= 10 ORDER BY tabid"]
+    set rows [$stmt allrows -as lists]
+    set rs [$stmt execute]
+    # The columns hold the rows not yet read, buffered ones included
+    $rs nextlist
+    set columns [$rs allcolumns]
+    $rs close
+    $stmt close
+    set rows [lrange $rows 1 end]
+    puts "  tabid: [dict get $columns tabid]"
+    if {[dict keys $columns] ne "tabid tabname" ||
+            [dict get $columns tabid] ne [lmap row $rows {lindex $row 0}] ||
+            [dict get $columns tabname] ne [lmap row $rows {lindex $row 1}]} {
+        error "columns differ from the rows"
+    }
+} err]} {
+    puts stderr "Test 28 failed: $err"
+}
+
+# Test a BYTE value round trip as a byte array
+puts "\n=== Test 29: binary values ==="
+if {[catch {
+    set data [binary format c* [lrepeat 100 0 1 2 127 -128 -1 0 10 13 0]]
+    set stmt [db prepare "INSERT INTO tdbc_blob (id, data) VALUES (3, :data)"]
+    $stmt execute
+    $stmt close
+    
+    set stmt [db prepare "SELECT data FROM tdbc_blob WHERE id = 3"]
+    set value [lindex [$stmt allrows -as lists] 0 0]
+    $stmt close
+    binary scan $value H16 head
+    puts "  [string length $value] bytes, starting $head"
+    if {$value ne $data} {
+        error "value read back differs from the one written"
+    }
+} err]} {
+    puts stderr "Test 29 failed: $err"
+}
+
+# Test native export
+puts "\n=== Test 30: export ==="
+if {[catch {
+    set f [file tempfile path]
+    set stmt [db prepare "SELECT id, name FROM tdbc_test ORDER BY id"]
+    set rs [$stmt execute]
+    set n [$rs export $f -format csv]
+    $rs close
+    $stmt close
+    close $f
+    
+    set f [open $path r]
+    set lines [split [string trimright [read $f] \n] \n]
+    close $f
+    puts "  Exported $n rows, first: [lindex $lines 0]"
+    if {[llength $lines] != $n} {
+        error "$n rows exported but [llength $lines] lines written"
+    }
+    
+    # Control characters are escaped in JSON lines
+    set text ""
+    set escaped ""
+    for {set c 1} {$c < 32} {incr c} {
+        append text [format %c $c]
+        switch $c {
+            9 { append escaped {\t} }
+            10 { append escaped {\n} }
+            13 { append escaped {\r} }
+            default { append escaped [format {\u%04x} $c] }
+        }
+    }
+    set stmt [db prepare "INSERT INTO tdbc_blob (id, body) VALUES (4, :text)"]
+    $stmt execute
+    $stmt close
+    
+    set f [open $path w]
+    set stmt [db prepare "SELECT body FROM tdbc_blob WHERE id = 4"]
+    set rs [$stmt execute]
+    $rs export $f -format jsonl
+    $rs close
+    $stmt close
+    close $f
+    
+    set f [open $path r]
+    set line [string trimright [read $f] \n]
+    close $f
+    file delete $path
+    puts "  JSON line: $line"
+    if {$line ne "{\"body\":\"$escaped\"}"} {
+        error "expected the control characters escaped"
+    }
+} err]} {
+    puts stderr "Test 30 failed: $err"
+}
+
+# Test bulk load of an unload file
+puts "\n=== Test 31: load ==="
+if {[catch {
+    set f [file tempfile path]
+    puts $f "10|ten|"
+    puts $f "11|eleven|"
+    puts $f "12|twelve|extra|"
+    puts $f "13|thirteen|"
+    close $f
+    
+    set f [open $path r]
+    set status [db load tdbc_test $f -batch 2 -commit 2]
+    close $f
+    puts "  Status: $status"
+    if {[dict get $status records] != 4 || [dict get $status errors] ne "3"} {
+        error "expected 4 records with record 3 rejected"
+    }
+    
+    # -commit would end the caller's transaction
+    db begintransaction
+    set f [open $path r]
+    set refused [catch {db load tdbc_test $f -commit 2} msg]
+    close $f
+    db rollback
+    puts "  -commit in a transaction: $msg"
+    if {!$refused} {
+        error "-commit was accepted inside a transaction"
+    }
+    file delete $path
+} err]} {
+    puts stderr "Test 31 failed: $err"
+}
+
+# Test the statement cache of ad-hoc allrows/foreach
+puts "\n=== Test 32: -stmtcache ==="
+if {[catch {
+    ::ifx::odbc::connection create cdb "DSN=eppixprod" -stmtcache 2
+    set a "SELECT tabname FROM systables WHERE tabid = 1"
+    set b "SELECT tabname FROM systables WHERE tabid = 2"
+    set c "SELECT tabname FROM systables WHERE tabid = 3"
+    
+    # a b a c b: c drops b (a was used later), b drops a
+    foreach sql [list $a $b $a $c $b] {
+        cdb allrows $sql
+    }
+    set stats [cdb cachestats]
+    puts "  After a b a c b: $stats"
+    if {[dict get $stats hits] != 1 || [dict get $stats misses] != 4 ||
+            [dict get $stats evictions] != 2 || [dict get $stats size] != 2} {
+        error "expected 1 hit, 4 misses, 2 evictions"
+    }
+    # c is cached and becomes the most recent, so a drops b
+    cdb allrows $c
+    cdb allrows $a
+    cdb allrows $c
+    set stats [cdb cachestats]
+    puts "  After c a c: $stats"
+    if {[dict get $stats hits] != 3 || [dict get $stats misses] != 5} {
+        error "expected c to stay cached"
+    }
+    
+    # The inner call can't reuse the statement the outer loop reads from
+    set inner {}
+    cdb foreach -as lists row $a {
+        lappend inner [cdb allrows -as lists $a]
+    }
+    puts "  Nested foreach: $inner"
+    set stats [cdb cachestats]
+    if {[llength $inner] != [llength [lindex $inner 0]] ||
+            [dict get $stats hits] != 4 || [dict get $stats misses] != 6} {
+        error "expected the outer loop to hit and the inner call to miss"
+    }
+    
+    cdb configure -stmtcache 0
+    set stats [cdb cachestats]
+    puts "  After -stmtcache 0: $stats"
+    if {[dict get $stats size] != 0 || [dict get $stats evictions] != 5} {
+        error "expected the cache to be emptied"
+    }
+    cdb close
+} err]} {
+    puts stderr "Test 32 failed: $err"
+}
+
+# Test the DSN registry
+puts "\n=== Test 33: datasources ==="
+if {[catch {
+    set all [::ifx::odbc::datasources]
+    set user [::ifx::odbc::datasources -user]
+    set system [::ifx::odbc::datasources -system]
+    puts "  User: $user"
+    puts "  System: $system"
+    if {[lsort -unique [concat $user $system]] ne $all} {
+        error "expected the user and system DSNs to make up all of them"
+    }
+    if {[::ifx::odbc::datasources] ne $all} {
+        error "a second call returned other DSNs"
+    }
+    if {![catch {::ifx::odbc::datasources -bogus} msg]} {
+        error "an unknown option was accepted"
+    }
+} err]} {
+    puts stderr "Test 33 failed: $err"
+}
+
 # Cleanup
 puts "\n=== Cleanup ==="
 db close